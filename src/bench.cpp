@@ -0,0 +1,57 @@
+#include "bench.h"
+#include "search.h"
+#include "tt.h"
+
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+namespace ct2 {
+
+namespace {
+
+const char* const BENCH_FENS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+    "2r3k1/pp3ppp/2n1b3/3p4/3P4/2NB1N2/PP3PPP/2R3K1 w - - 0 20",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+};
+
+} // namespace
+
+void run_bench(int depth, int maxThreads, std::ostream& out) {
+    const int savedThreads = search_threads();
+    std::vector<int> counts;
+    for (int t = 1; t < maxThreads; t *= 2) counts.push_back(t);
+    counts.push_back(maxThreads);
+
+    double baseMs = 0;
+    for (int threads : counts) {
+        set_search_threads(threads);
+        uint64_t nodes = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const char* fen : BENCH_FENS) {
+            Board b;
+            b.loadFEN(fen);
+            TT.clear();
+            SearchLimits limits;
+            limits.depth = depth;
+            nodes += search(b, limits).nodes;
+        }
+        double ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start).count();
+        if (threads == 1) baseMs = ms;
+        out << "threads " << threads
+            << " time " << uint64_t(ms) << " ms"
+            << " nodes " << nodes
+            << " nps " << uint64_t(nodes * 1000 / (ms > 0 ? ms : 1))
+            << " speedup " << (ms > 0 ? baseMs / ms : 0.0) << std::endl;
+    }
+    set_search_threads(savedThreads);
+}
+
+} // namespace ct2
@@ -0,0 +1,15 @@
+#ifndef CT2_BENCH_H
+#define CT2_BENCH_H
+
+#include <iosfwd>
+
+namespace ct2 {
+
+// Time-to-depth benchmark: searches a fixed position set to the given depth
+// with 1, 2, 4, ... up to maxThreads threads (clearing the hash before each
+// position) and prints time, nodes and speedup against one thread.
+void run_bench(int depth, int maxThreads, std::ostream& out);
+
+} // namespace ct2
+
+#endif // CT2_BENCH_H
@@ -6,6 +6,13 @@
 #  include <intrin.h>
 #endif
 
+// The BMI2 pext/pdep instructions can be emitted with inline assembly
+// without compiling the whole program for BMI2; callers decide at runtime
+// whether the CPU supports them.
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#  define CT2_BMI2_ASM 1
+#endif
+
 namespace ct2 {
 
 // Portable population count for 64-bit integers
@@ -43,6 +50,43 @@ inline int ctz64(uint64_t x) {
 #endif
 }
 
+// Portable parallel bit extract: gathers the bits of x selected by mask
+// into the low bits of the result
+inline uint64_t pext64(uint64_t x, uint64_t mask) {
+    uint64_t result = 0;
+    for (uint64_t bit = 1; mask; bit <<= 1) {
+        if (x & mask & -mask) result |= bit;
+        mask &= mask - 1;
+    }
+    return result;
+}
+
+// Portable parallel bit deposit: scatters the low bits of x to the
+// positions selected by mask
+inline uint64_t pdep64(uint64_t x, uint64_t mask) {
+    uint64_t result = 0;
+    for (uint64_t bit = 1; mask; bit <<= 1) {
+        if (x & bit) result |= mask & -mask;
+        mask &= mask - 1;
+    }
+    return result;
+}
+
+#if CT2_BMI2_ASM
+// Hardware versions; only valid on CPUs reporting BMI2
+inline uint64_t pext64_bmi2(uint64_t x, uint64_t mask) {
+    uint64_t result;
+    __asm__("pextq %2, %1, %0" : "=r"(result) : "r"(x), "rm"(mask));
+    return result;
+}
+
+inline uint64_t pdep64_bmi2(uint64_t x, uint64_t mask) {
+    uint64_t result;
+    __asm__("pdepq %2, %1, %0" : "=r"(result) : "r"(x), "rm"(mask));
+    return result;
+}
+#endif
+
 } // namespace ct2
 
 #endif // CT2_BITOPS_H
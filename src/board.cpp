@@ -1,10 +1,15 @@
 #include "board.h"
 #include "bitops.h"
+#include "psqt.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <iostream>
 #include <sstream>
+#if CT2_BMI2_ASM
+#  include <cpuid.h>
+#endif
 
 namespace ct2 {
 
@@ -28,46 +33,176 @@ inline int char_to_piece(char c) {
     }
 }
 
-bool is_valid_pawn_capture_distance(int from, int to, bool is_white) {
-    int rank_diff = (to / 8) - (from / 8);
-    int file_diff = (to % 8) - (from % 8);
-    
-    if (is_white) {
-        return rank_diff == 1 && (file_diff == 1 || file_diff == -1);
-    } else {
-        return rank_diff == -1 && (file_diff == 1 || file_diff == -1);
+constexpr uint64_t FILE_A = 0x0101010101010101ULL;
+constexpr uint64_t FILE_H = 0x8080808080808080ULL;
+constexpr uint64_t RANK_2 = 0x000000000000FF00ULL;
+constexpr uint64_t RANK_3 = 0x0000000000FF0000ULL;
+constexpr uint64_t RANK_6 = 0x0000FF0000000000ULL;
+constexpr uint64_t RANK_7 = 0x00FF000000000000ULL;
+
+// Moves every square of b by D (a pawn step or capture direction, from
+// white's point of view +8 north, +7 north-west, +9 north-east), dropping
+// squares that would wrap around the board edge
+template<int D>
+constexpr uint64_t shift(uint64_t b) {
+    static_assert(D == 8 || D == -8 || D == 7 || D == -7 || D == 9 || D == -9, "pawn direction");
+    return D ==  8 ? b << 8
+         : D == -8 ? b >> 8
+         : D ==  7 ? (b << 7) & ~FILE_H
+         : D ==  9 ? (b << 9) & ~FILE_A
+         : D == -7 ? (b >> 7) & ~FILE_A
+         :           (b >> 9) & ~FILE_H;
+}
+
+// Squares attacked by the pawns of colour C standing on bb
+template<Color C>
+constexpr uint64_t pawn_attacks_bb(uint64_t bb) {
+    return C == WHITE ? shift<7>(bb) | shift<9>(bb) : shift<-7>(bb) | shift<-9>(bb);
+}
+
+// ================= Leaper attack tables =====================
+// Built at compile time; nothing to initialise at startup.
+constexpr int KNIGHT_STEPS[8][2] = {{1,2},{2,1},{-1,2},{-2,1},{1,-2},{2,-1},{-1,-2},{-2,-1}};
+constexpr int KING_STEPS[8][2] = {{1,0},{1,1},{0,1},{-1,1},{-1,0},{-1,-1},{0,-1},{1,-1}};
+
+constexpr std::array<uint64_t, 64> make_leaper_table(const int (&steps)[8][2]) {
+    std::array<uint64_t, 64> table{};
+    for (int sq = 0; sq < 64; ++sq) {
+        int r = sq / 8, f = sq % 8;
+        for (const auto& s : steps) {
+            int r1 = r + s[0], f1 = f + s[1];
+            if (r1 >= 0 && r1 < 8 && f1 >= 0 && f1 < 8) table[sq] |= 1ULL << (r1 * 8 + f1);
+        }
+    }
+    return table;
+}
+
+constexpr std::array<std::array<uint64_t, 64>, COLOR_NB> make_pawn_table() {
+    std::array<std::array<uint64_t, 64>, COLOR_NB> table{};
+    for (int sq = 0; sq < 64; ++sq) {
+        table[WHITE][sq] = pawn_attacks_bb<WHITE>(1ULL << sq);
+        table[BLACK][sq] = pawn_attacks_bb<BLACK>(1ULL << sq);
     }
+    return table;
 }
 
+constexpr std::array<uint64_t, 64> knightAttacks = make_leaper_table(KNIGHT_STEPS);
+constexpr std::array<uint64_t, 64> kingAttacks = make_leaper_table(KING_STEPS);
+// Squares a pawn of the given colour on sq attacks
+constexpr std::array<std::array<uint64_t, 64>, COLOR_NB> pawnAttacks = make_pawn_table();
+
+// Rook origin and destination for the castling move whose king lands on kingTo
+inline void castling_rook_squares(int kingTo, int& rfrom, int& rto) {
+    switch (kingTo) {
+    case 6:  rfrom = 7;  rto = 5;  break;
+    case 2:  rfrom = 0;  rto = 3;  break;
+    case 62: rfrom = 63; rto = 61; break;
+    default: rfrom = 56; rto = 59; break;
+    }
+}
+
+// ================= Zobrist keys =====================
+struct ZobristKeys {
+    uint64_t psq[PIECE_NB][64];
+    uint64_t castling[16];
+    uint64_t enpassant[8];
+    uint64_t side;
+};
+
+constexpr uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys make_zobrist_keys() {
+    ZobristKeys z{};
+    uint64_t state = 0x2024C72ULL;
+    for (int p = 0; p < PIECE_NB; ++p)
+        for (int sq = 0; sq < 64; ++sq)
+            z.psq[p][sq] = splitmix64(state);
+    // one key per combination of rights so updates are a single XOR
+    for (int cr = 0; cr < 16; ++cr)
+        z.castling[cr] = splitmix64(state);
+    for (int f = 0; f < 8; ++f)
+        z.enpassant[f] = splitmix64(state);
+    z.side = splitmix64(state);
+    return z;
+}
+
+constexpr ZobristKeys Zobrist = make_zobrist_keys();
+
 } // namespace
 
 Board::Board() {
     bitboards.fill(0);
     occupancies.fill(0);
+    mailbox.fill(PIECE_NB);
     side = WHITE;
     castling = 0;
     ep_square = -1;
+    halfmove = 0;
+    zobrist = compute_key();
+    psq = 0;
+    gamePhase = 0;
+    history.reserve(256);
 }
 
-void Board::update_occupancies() {
-    occupancies[WHITE] = bitboards[WP] | bitboards[WN] | bitboards[WB] |
-                         bitboards[WR] | bitboards[WQ] | bitboards[WK];
-    occupancies[BLACK] = bitboards[BP] | bitboards[BN] | bitboards[BB] |
-                         bitboards[BR] | bitboards[BQ] | bitboards[BK];
-    occupancies[2] = occupancies[WHITE] | occupancies[BLACK];
+// The en passant square only enters the hash when a pawn of the side to move
+// can actually capture on it, so transpositions that differ only by a dead
+// ep square share a key.
+bool Board::ep_capturable() const {
+    if (ep_square == -1) return false;
+    Piece ourPawn = side == WHITE ? WP : BP;
+    return pawnAttacks[side ^ 1][ep_square] & bitboards[ourPawn];
+}
+
+int32_t Board::compute_psq() const {
+    Score score = 0;
+    for (int sq = 0; sq < 64; ++sq)
+        if (mailbox[sq] != PIECE_NB) score += PSQT[mailbox[sq]][sq];
+    return score;
+}
+
+int Board::compute_phase() const {
+    int phase = 0;
+    for (int sq = 0; sq < 64; ++sq)
+        if (mailbox[sq] != PIECE_NB) phase += PHASE_WEIGHT[mailbox[sq] % 6];
+    return phase;
+}
+
+uint64_t Board::compute_key() const {
+    uint64_t k = 0;
+    for (int p = WP; p < PIECE_NB; ++p) {
+        uint64_t bb = bitboards[p];
+        while (bb) {
+            int sq = ctz64(bb);
+            bb &= bb - 1;
+            k ^= Zobrist.psq[p][sq];
+        }
+    }
+    k ^= Zobrist.castling[castling];
+    if (ep_capturable()) k ^= Zobrist.enpassant[ep_square % 8];
+    if (side == BLACK) k ^= Zobrist.side;
+    return k;
 }
 
 bool Board::loadFEN(const std::string& fen) {
     bitboards.fill(0);
     occupancies.fill(0);
+    mailbox.fill(PIECE_NB);
     side = WHITE;
     castling = 0;
     ep_square = -1;
+    halfmove = 0;
+    history.clear();
 
     std::istringstream iss(fen);
     std::string boardPart, sidePart, castlingPart, ep;
     if (!(iss >> boardPart >> sidePart >> castlingPart >> ep))
         return false;
+    if (!(iss >> halfmove)) halfmove = 0;
 
     int sq = 56; // start from A8
     for (char c : boardPart) {
@@ -78,7 +213,9 @@ bool Board::loadFEN(const std::string& fen) {
         } else {
             int p = char_to_piece(c);
             if (p < 0) return false;
+            if (sq < 0 || sq > 63) return false;
             bitboards[p] |= 1ULL << sq;
+            mailbox[sq] = Piece(p);
             sq++;
         }
     }
@@ -102,6 +239,9 @@ bool Board::loadFEN(const std::string& fen) {
     occupancies[BLACK] = bitboards[BP] | bitboards[BN] | bitboards[BB] |
                          bitboards[BR] | bitboards[BQ] | bitboards[BK];
     occupancies[2] = occupancies[WHITE] | occupancies[BLACK];
+    zobrist = compute_key();
+    psq = compute_psq();
+    gamePhase = compute_phase();
 
     return true;
 }
@@ -112,18 +252,13 @@ std::string Board::getFEN() const {
     for (int rank = 7; rank >= 0; --rank) {
         int empty = 0;
         for (int file = 0; file < 8; ++file) {
-            int sq = rank * 8 + file;
-            bool found = false;
-            for (int p = 0; p < PIECE_NB; ++p) {
-                if (bitboards[p] & (1ULL << sq)) {
-                    if (empty) { s += char('0' + empty); empty = 0; }
-                    const char* pieces = "PNBRQKpnbrqk";
-                    s += pieces[p];
-                    found = true;
-                    break;
-                }
+            Piece p = mailbox[rank * 8 + file];
+            if (p == PIECE_NB) {
+                empty++;
+                continue;
             }
-            if (!found) empty++;
+            if (empty) { s += char('0' + empty); empty = 0; }
+            s += "PNBRQKpnbrqk"[p];
         }
         if (empty) s += char('0' + empty);
         if (rank > 0) s += '/';
@@ -148,9 +283,25 @@ std::string Board::getFEN() const {
     return s;
 }
 
+std::string sq_to_str(int sq) {
+    std::string s(2,'a');
+    s[0] = 'a' + (sq % 8);
+    s[1] = '1' + (sq / 8);
+    return s;
+}
+
+std::string move_to_str(Move m) {
+    std::string s = sq_to_str(m.from()) + sq_to_str(m.to());
+    if (m.type() == PROMOTION)
+        s += "nbrq"[m.promotion_type() - WN];
+    return s;
+}
+
 // ================= Move generation =====================
-static std::array<uint64_t, 64> knightAttacks;
-static std::array<uint64_t, 64> kingAttacks;
+// Squares strictly between two aligned squares, and the full board line
+// through them; both empty when the squares are not on a common line
+static uint64_t betweenBB[64][64];
+static uint64_t lineBB[64][64];
 
 static int pop_lsb(uint64_t& b) {
     int sq = ctz64(b);
@@ -158,23 +309,151 @@ static int pop_lsb(uint64_t& b) {
     return sq;
 }
 
-std::vector<Board::Move> Board::generate_moves() const {
-    std::vector<Move> moves;
-    uint64_t own = occupancies[side];
-    uint64_t opp = occupancies[side ^ 1];
+template<Color By>
+bool Board::attacked_by(int sq, uint64_t occ) const {
+    if (pawnAttacks[By ^ 1][sq] & bitboards[make_piece(By, WP)]) return true;
+    if (knightAttacks[sq] & bitboards[make_piece(By, WN)]) return true;
+    const uint64_t queens = bitboards[make_piece(By, WQ)];
+    if (bishop_attacks(sq, occ) & (bitboards[make_piece(By, WB)] | queens)) return true;
+    if (rook_attacks(sq, occ) & (bitboards[make_piece(By, WR)] | queens)) return true;
+    return kingAttacks[sq] & bitboards[make_piece(By, WK)];
+}
+
+// With Legal set, checkers, pinned pieces and the check-block mask are
+// computed once up front and only legal moves are emitted. Without it the
+// output is pseudo-legal and is_legal() has to be applied per move.
+template<Color Us, GenType Type, bool Legal>
+void Board::generate_all(MoveList& moves) const {
+    constexpr Color Them = Color(Us ^ 1);
+    constexpr int Up = Us == WHITE ? 8 : -8;
+    constexpr int CaptureA = Us == WHITE ? 7 : -7; // towards the a-file for white
+    constexpr int CaptureB = Us == WHITE ? 9 : -9;
+    constexpr uint64_t Rank3BB = Us == WHITE ? RANK_3 : RANK_6; // after a double push's first step
+    constexpr uint64_t Rank7BB = Us == WHITE ? RANK_7 : RANK_2; // pawns about to promote
+    constexpr bool genQuiets = Type != CAPTURES;
+    constexpr bool genTactical = Type == CAPTURES || Type == EVASIONS || Type == NON_EVASIONS;
+    const uint64_t own = occupancies[Us];
+    const uint64_t opp = occupancies[Them];
+    const uint64_t empty = ~occupancies[2];
+    const int ksq = ctz64(bitboards[make_piece(Us, WK)]);
+
+    // Squares a non-king move must land on: the checker or a blocking
+    // square when in single check, nothing in double check
+    uint64_t checkersBB = 0;
+    uint64_t checkmask = ~0ULL;
+    if (Legal || Type == EVASIONS) {
+        checkersBB = checkers();
+        if (checkersBB)
+            checkmask = (checkersBB & (checkersBB - 1)) ? 0
+                        : betweenBB[ksq][ctz64(checkersBB)] | checkersBB;
+    }
+    assert(Type != EVASIONS || checkersBB);
+
+    // Our pieces that are the only blocker between the king and an enemy slider
+    uint64_t pinned = 0;
+    if constexpr (Legal) {
+        uint64_t queens = bitboards[make_piece(Them, WQ)];
+        uint64_t snipers = (rook_attacks(ksq, 0) & (bitboards[make_piece(Them, WR)] | queens))
+                         | (bishop_attacks(ksq, 0) & (bitboards[make_piece(Them, WB)] | queens));
+        while (snipers) {
+            uint64_t b = betweenBB[ksq][pop_lsb(snipers)] & occupancies[2];
+            if (b && !(b & (b - 1)) && (b & own)) pinned |= b;
+        }
+    }
+    auto pin_mask = [&](int from) -> uint64_t {
+        return (pinned >> from & 1) ? lineBB[ksq][from] : ~0ULL;
+    };
+
+    // Destinations for pieces, pawns and the king respectively
+    uint64_t target = Type == CAPTURES ? opp
+                    : (Type == NON_EVASIONS || Type == EVASIONS) ? ~own : empty;
+    const uint64_t kingTarget = target;
+    target &= checkmask;
+    const uint64_t pawnTarget = checkmask;
+
+    // For QUIET_CHECKS: the squares from which each piece type attacks the
+    // enemy king, and our pieces that uncover a slider on it when they move
+    std::array<uint64_t, 6> checkSquares{};
+    uint64_t discoverers = 0;
+    int theirKsq = 0;
+    if constexpr (Type == QUIET_CHECKS) {
+        theirKsq = ctz64(bitboards[make_piece(Them, WK)]);
+        uint64_t occ = occupancies[2];
+        uint64_t queens = bitboards[make_piece(Us, WQ)];
+        checkSquares[WP] = pawnAttacks[Them][theirKsq];
+        checkSquares[WN] = knightAttacks[theirKsq];
+        checkSquares[WB] = bishop_attacks(theirKsq, occ);
+        checkSquares[WR] = rook_attacks(theirKsq, occ);
+        checkSquares[WQ] = checkSquares[WB] | checkSquares[WR];
+        uint64_t snipers = (rook_attacks(theirKsq, 0) & (bitboards[make_piece(Us, WR)] | queens))
+                         | (bishop_attacks(theirKsq, 0) & (bitboards[make_piece(Us, WB)] | queens));
+        while (snipers) {
+            uint64_t b = betweenBB[theirKsq][pop_lsb(snipers)] & occ;
+            if (b && !(b & (b - 1)) && (b & own)) discoverers |= b;
+        }
+    }
+    auto checks = [&](int from, uint64_t to, int pieceType) -> uint64_t {
+        if constexpr (Type != QUIET_CHECKS) return to;
+        if (discoverers & (1ULL << from))
+            return to & (checkSquares[pieceType] | ~lineBB[theirKsq][from]);
+        return to & checkSquares[pieceType];
+    };
+
+    // Pawn moves to the squares in bb, each made from delta squares back
+    auto add_pawn_moves = [&](uint64_t bb, int delta) {
+        while (bb) {
+            int to = pop_lsb(bb);
+            int from = to - delta;
+            if (Legal && !(pin_mask(from) >> to & 1)) continue;
+            if (checks(from, 1ULL << to, WP))
+                moves.push_back(Move(from, to));
+        }
+    };
+
+    auto add_promotions = [&](uint64_t bb, int delta) {
+        while (bb) {
+            int to = pop_lsb(bb);
+            int from = to - delta;
+            if (Legal && !(pin_mask(from) >> to & 1)) continue;
+            moves.push_back(Move(from, to, PROMOTION, WQ));
+            moves.push_back(Move(from, to, PROMOTION, WR));
+            moves.push_back(Move(from, to, PROMOTION, WB));
+            moves.push_back(Move(from, to, PROMOTION, WN));
+        }
+    };
+
+    // En passant can uncover a rank attack through two pawns at once, so it
+    // gets the full king-safety test
+    auto add_en_passant = [&](uint64_t bb, int delta) {
+        if (bb) {
+            int to = ctz64(bb);
+            Move m(to - delta, to, EN_PASSANT);
+            if (!Legal || is_legal(m)) moves.push_back(m);
+        }
+    };
+
+    auto add_castling = [&](int right, int kfrom, int kto, uint64_t path) {
+        if (!(castling & right) || (occupancies[2] & path)) return;
+        if constexpr (Legal) {
+            if (checkersBB) return;
+            int step = kto > kfrom ? 1 : -1;
+            for (int sq = kfrom + step; ; sq += step) {
+                if (attacked_by<Them>(sq, occupancies[2])) return;
+                if (sq == kto) break;
+            }
+        }
+        moves.push_back(Move(kfrom, kto, CASTLING));
+    };
 
     auto add_leaper = [&](Piece p, const std::array<uint64_t,64>& table) {
         uint64_t bb = bitboards[p];
         while (bb) {
             int from = pop_lsb(bb);
-            uint64_t targets = table[from] & ~own;
+            uint64_t targets = checks(from, table[from] & target & pin_mask(from), p % 6);
             uint64_t t = targets;
             while (t) {
                 int to = pop_lsb(t);
-                Piece cap = PIECE_NB;
-                if (opp & (1ULL<<to))
-                    for (int pc=WP; pc<PIECE_NB; ++pc) if (bitboards[pc] & (1ULL<<to)) cap=(Piece)pc;
-                moves.push_back({from,to,p,cap,PIECE_NB,false,false});
+                moves.push_back(Move(from, to));
             }
         }
     };
@@ -185,209 +464,142 @@ std::vector<Board::Move> Board::generate_moves() const {
             int from = pop_lsb(bb);
             uint64_t targets = bishopLike ? bishop_attacks(from, occupancies[2])
                                          : rook_attacks(from, occupancies[2]);
-            targets &= ~own;
+            targets = checks(from, targets & target & pin_mask(from), p % 6);
             uint64_t t = targets;
             while (t) {
                 int to = pop_lsb(t);
-                Piece cap = PIECE_NB;
-                if (opp & (1ULL<<to))
-                    for (int pc=WP; pc<PIECE_NB; ++pc) if (bitboards[pc] & (1ULL<<to)) cap=(Piece)pc;
-                moves.push_back({from,to,p,cap,PIECE_NB,false,false});
+                moves.push_back(Move(from, to));
             }
         }
     };
 
-    if (side == WHITE) {
-        uint64_t pawns = bitboards[WP];
-        uint64_t single = (pawns << 8) & ~occupancies[2];
-        uint64_t t = single;
-        while (t) {
-            int to = pop_lsb(t);
-            int from = to - 8;
-            if (to >= 56)
-                moves.push_back({from,to,WP,PIECE_NB,WQ,false,false});
-            else
-                moves.push_back({from,to,WP,PIECE_NB,PIECE_NB,false,false});
-        }
-        uint64_t dbl = ((single & 0x0000000000FF0000ULL) << 8) & ~occupancies[2];
-        t = dbl;
-        while (t) {
-            int to = pop_lsb(t);
-            int from = to - 16;
-            moves.push_back({from,to,WP,PIECE_NB,PIECE_NB,false,false});
-        }
-        uint64_t captL = ((pawns & ~0x0101010101010101ULL) << 7) & opp;
-        t = captL;
-        while (t) {
-            int to = pop_lsb(t);
-            int from = to - 7;
-            if (is_valid_pawn_capture_distance(from, to, true)) {
-                Piece cap = PIECE_NB;
-                for(int pc=WP;pc<PIECE_NB;++pc) 
-                    if(bitboards[pc]&(1ULL<<to)) 
-                        cap=(Piece)pc;
-                if (to >= 56)
-                    moves.push_back({from,to,WP,cap,WQ,false,false});
-                else
-                    moves.push_back({from,to,WP,cap,PIECE_NB,false,false});
-            }
-        }
-        uint64_t captR = ((pawns & ~0x8080808080808080ULL) << 9) & opp;
-        t = captR;
-        while (t) {
-            int to = pop_lsb(t);
-            int from = to - 9;
-            if (is_valid_pawn_capture_distance(from, to, true)) {
-                Piece cap = PIECE_NB;
-                for(int pc=WP;pc<PIECE_NB;++pc) 
-                    if(bitboards[pc]&(1ULL<<to)) 
-                        cap=(Piece)pc;
-                if (to >= 56)
-                    moves.push_back({from,to,WP,cap,WQ,false,false});
-                else
-                    moves.push_back({from,to,WP,cap,PIECE_NB,false,false});
-            }
-        }
-        if (ep_square != -1) {
-            uint64_t epBB = 1ULL << ep_square;
-            uint64_t epL = ((pawns & ~0x0101010101010101ULL) << 7) & epBB;
-            t = epL;
-            while (t) {
-                int to = pop_lsb(t);
-                int from = to - 7;
-                moves.push_back({from,to,WP,BP,PIECE_NB,true,false});
-            }
-            uint64_t epR = ((pawns & ~0x8080808080808080ULL) << 9) & epBB;
-            t = epR;
-            while (t) {
-                int to = pop_lsb(t);
-                int from = to - 9;
-                moves.push_back({from,to,WP,BP,PIECE_NB,true,false});
-            }
-        }
-        if ((castling & 1) && !(occupancies[2] & ((1ULL<<5)|(1ULL<<6))))
-            moves.push_back({4,6,WK,PIECE_NB,PIECE_NB,false,true});
-        if ((castling & 2) && !(occupancies[2] & ((1ULL<<1)|(1ULL<<2)|(1ULL<<3))))
-            moves.push_back({4,2,WK,PIECE_NB,PIECE_NB,false,true});
-        add_leaper(WN, knightAttacks);
-        add_slider(WB, true);
-        add_slider(WR, false);
-        add_slider(WQ, true);
-        add_slider(WQ, false);
-        add_leaper(WK, kingAttacks);
-    } else {
-        uint64_t pawns = bitboards[BP];
-        uint64_t single = (pawns >> 8) & ~occupancies[2];
-        uint64_t t = single;
-        while (t) {
-            int to = pop_lsb(t);
-            int from = to + 8;
-            if (to < 8)
-                moves.push_back({from,to,BP,PIECE_NB,BQ,false,false});
-            else
-                moves.push_back({from,to,BP,PIECE_NB,PIECE_NB,false,false});
-        }
-        uint64_t dbl = ((single & 0x0000FF0000000000ULL) >> 8) & ~occupancies[2];
-        t = dbl;
-        while (t) {
-            int to = pop_lsb(t);
-            int from = to + 16;
-            moves.push_back({from,to,BP,PIECE_NB,PIECE_NB,false,false});
-        }
-        // Captures to the pawn's left (towards file decrease).
-        // Pawns on the h-file cannot capture left so mask them out.
-        uint64_t captL = ((pawns & ~0x8080808080808080ULL) >> 7) & opp;
-        t = captL;
-        while (t) {
-            int to = pop_lsb(t);
-            int from = to + 7;
-            if (is_valid_pawn_capture_distance(from, to, false)) {
-                Piece cap = PIECE_NB;
-                for(int pc=WP;pc<PIECE_NB;++pc) 
-                    if(bitboards[pc]&(1ULL<<to)) 
-                        cap=(Piece)pc;
-                if (to < 8)
-                    moves.push_back({from,to,BP,cap,BQ,false,false});
-                else
-                    moves.push_back({from,to,BP,cap,PIECE_NB,false,false});
-            }
-        }
-        // Captures to the pawn's right (towards file increase).
-        // Pawns on the a-file cannot capture right so mask them out.
-        uint64_t captR = ((pawns & ~0x0101010101010101ULL) >> 9) & opp;
-        t = captR;
+    // The king steps out of the check-block mask; in legal mode each square
+    // is tested with the king lifted off the board so sliders see through it
+    auto add_king = [&]() {
+        uint64_t t = checks(ksq, kingAttacks[ksq] & kingTarget, WK);
         while (t) {
             int to = pop_lsb(t);
-            int from = to + 9;
-            if (is_valid_pawn_capture_distance(from, to, false)) {
-                Piece cap = PIECE_NB;
-                for(int pc=WP;pc<PIECE_NB;++pc) 
-                    if(bitboards[pc]&(1ULL<<to)) 
-                        cap=(Piece)pc;
-                if (to < 8)
-                    moves.push_back({from,to,BP,cap,BQ,false,false});
-                else
-                    moves.push_back({from,to,BP,cap,PIECE_NB,false,false});
-            }
+            if (!Legal || !attacked_by<Them>(to, occupancies[2] ^ (1ULL << ksq)))
+                moves.push_back(Move(ksq, to));
         }
-        if (ep_square != -1) {
+    };
+
+    const uint64_t pawns = bitboards[make_piece(Us, WP)];
+    const uint64_t promoters = pawns & Rank7BB;
+    const uint64_t others = pawns & ~Rank7BB;
+    if constexpr (genQuiets) {
+        uint64_t single = shift<Up>(others) & empty;
+        uint64_t dbl = shift<Up>(single & Rank3BB) & empty;
+        add_pawn_moves(single & pawnTarget, Up);
+        add_pawn_moves(dbl & pawnTarget, 2 * Up);
+    }
+    if constexpr (genTactical) {
+        // Every promotion counts as tactical, pushes included
+        add_promotions(shift<Up>(promoters) & empty & pawnTarget, Up);
+        add_promotions(shift<CaptureA>(promoters) & opp & pawnTarget, CaptureA);
+        add_promotions(shift<CaptureB>(promoters) & opp & pawnTarget, CaptureB);
+        add_pawn_moves(shift<CaptureA>(others) & opp & pawnTarget, CaptureA);
+        add_pawn_moves(shift<CaptureB>(others) & opp & pawnTarget, CaptureB);
+        // when evading, ep must either block or take the checking pawn
+        if (ep_square != -1 && (!checkersBB || ((checkmask | shift<Up>(checkersBB)) >> ep_square & 1))) {
             uint64_t epBB = 1ULL << ep_square;
-            // En passant capture to the left
-            uint64_t epL = ((pawns & ~0x8080808080808080ULL) >> 7) & epBB;
-            t = epL;
-            while (t) {
-                int to = pop_lsb(t);
-                int from = to + 7;
-                moves.push_back({from,to,BP,WP,PIECE_NB,true,false});
-            }
-            // En passant capture to the right
-            uint64_t epR = ((pawns & ~0x0101010101010101ULL) >> 9) & epBB;
-            t = epR;
-            while (t) {
-                int to = pop_lsb(t);
-                int from = to + 9;
-                moves.push_back({from,to,BP,WP,PIECE_NB,true,false});
-            }
+            add_en_passant(shift<CaptureA>(others) & epBB, CaptureA);
+            add_en_passant(shift<CaptureB>(others) & epBB, CaptureB);
         }
-        if ((castling & 4) && !(occupancies[2] & ((1ULL<<61)|(1ULL<<62))))
-            moves.push_back({60,62,BK,PIECE_NB,PIECE_NB,false,true});
-        if ((castling & 8) && !(occupancies[2] & ((1ULL<<57)|(1ULL<<58)|(1ULL<<59))))
-            moves.push_back({60,58,BK,PIECE_NB,PIECE_NB,false,true});
-        add_leaper(BN, knightAttacks);
-        add_slider(BB, true);
-        add_slider(BR, false);
-        add_slider(BQ, true);
-        add_slider(BQ, false);
-        add_leaper(BK, kingAttacks);
     }
+    if constexpr (Type == QUIETS || Type == NON_EVASIONS) {
+        constexpr int kfrom = Us == WHITE ? 4 : 60;
+        constexpr uint64_t kingSide = 0x60ULL << (kfrom - 4);
+        constexpr uint64_t queenSide = 0x0EULL << (kfrom - 4);
+        add_castling(Us == WHITE ? 1 : 4, kfrom, kfrom + 2, kingSide);
+        add_castling(Us == WHITE ? 2 : 8, kfrom, kfrom - 2, queenSide);
+    }
+    add_leaper(make_piece(Us, WN), knightAttacks);
+    add_slider(make_piece(Us, WB), true);
+    add_slider(make_piece(Us, WR), false);
+    add_slider(make_piece(Us, WQ), true);
+    add_slider(make_piece(Us, WQ), false);
+    add_king();
+}
+
+template<GenType Type>
+void Board::generate(MoveList& moves) const {
+    if (side == WHITE) generate_all<WHITE, Type, true>(moves);
+    else generate_all<BLACK, Type, true>(moves);
+}
+
+template void Board::generate<CAPTURES>(MoveList&) const;
+template void Board::generate<QUIETS>(MoveList&) const;
+template void Board::generate<QUIET_CHECKS>(MoveList&) const;
+template void Board::generate<EVASIONS>(MoveList&) const;
+template void Board::generate<NON_EVASIONS>(MoveList&) const;
+
+void Board::generate_moves(MoveList& moves) const {
+    moves.clear();
+    if (side == WHITE) generate_all<WHITE, NON_EVASIONS, false>(moves);
+    else generate_all<BLACK, NON_EVASIONS, false>(moves);
+}
 
-    return moves;
+DecodedMove Board::decode(Move m) const {
+    DecodedMove d;
+    d.from = m.from();
+    d.to = m.to();
+    d.piece = mailbox[d.from];
+    d.is_ep = m.type() == EN_PASSANT;
+    d.is_castling = m.type() == CASTLING;
+    d.capture = d.is_ep ? make_piece(Color(side ^ 1), WP) : mailbox[d.to];
+    d.promotion = m.type() == PROMOTION ? make_piece(side, m.promotion_type()) : PIECE_NB;
+    return d;
 }
 
-bool Board::make_move(const Move& m) {
+bool Board::make_move(Move move) {
+    const DecodedMove m = decode(move);
     assert(m.piece >= 0 && m.piece < PIECE_NB);
-    assert(m.from >= 0 && m.from < 64);
-    assert(m.to >= 0 && m.to < 64);
+    history.push_back({zobrist, psq, m.capture, int16_t(halfmove), castling, int8_t(ep_square),
+                       uint8_t(gamePhase)});
+
+    Color us = side, them = (side == WHITE ? BLACK : WHITE);
     uint64_t fromBB = 1ULL << m.from;
     uint64_t toBB = 1ULL << m.to;
-    bitboards[m.piece] &= ~fromBB;
-    bitboards[m.piece] |= toBB;
-    if (m.is_castling) {
-        if (m.to == 6) { bitboards[WR] &= ~(1ULL<<7); bitboards[WR] |= (1ULL<<5); }
-        else if (m.to == 2) { bitboards[WR] &= ~(1ULL<<0); bitboards[WR] |= (1ULL<<3); }
-        else if (m.to == 62) { bitboards[BR] &= ~(1ULL<<63); bitboards[BR] |= (1ULL<<61); }
-        else if (m.to == 58) { bitboards[BR] &= ~(1ULL<<56); bitboards[BR] |= (1ULL<<59); }
+    uint64_t k = zobrist;
+    if (ep_capturable()) k ^= Zobrist.enpassant[ep_square % 8];
+    k ^= Zobrist.castling[castling];
+    k ^= Zobrist.psq[m.piece][m.from] ^ Zobrist.psq[m.piece][m.to];
+    Score score = psq - PSQT[m.piece][m.from] + PSQT[m.piece][m.to];
+    if (m.capture != PIECE_NB) {
+        int capSq = m.is_ep ? (us == WHITE ? m.to - 8 : m.to + 8) : m.to;
+        bitboards[m.capture] ^= 1ULL << capSq;
+        occupancies[them] ^= 1ULL << capSq;
+        mailbox[capSq] = PIECE_NB;
+        k ^= Zobrist.psq[m.capture][capSq];
+        score -= PSQT[m.capture][capSq];
+        gamePhase -= PHASE_WEIGHT[m.capture % 6];
     }
-    if (m.is_ep) {
-        if (m.piece == WP) bitboards[BP] &= ~(toBB >> 8);
-        else bitboards[WP] &= ~(toBB << 8);
-    } else if (m.capture != PIECE_NB) {
-        bitboards[m.capture] &= ~toBB;
+    bitboards[m.piece] ^= fromBB | toBB;
+    occupancies[us] ^= fromBB | toBB;
+    mailbox[m.from] = PIECE_NB;
+    mailbox[m.to] = m.piece;
+    if (m.is_castling) {
+        int rfrom, rto;
+        castling_rook_squares(m.to, rfrom, rto);
+        Piece rook = us == WHITE ? WR : BR;
+        uint64_t rookBB = (1ULL << rfrom) | (1ULL << rto);
+        bitboards[rook] ^= rookBB;
+        occupancies[us] ^= rookBB;
+        mailbox[rfrom] = PIECE_NB;
+        mailbox[rto] = rook;
+        k ^= Zobrist.psq[rook][rfrom] ^ Zobrist.psq[rook][rto];
+        score += PSQT[rook][rto] - PSQT[rook][rfrom];
     }
     if (m.promotion != PIECE_NB) {
-        bitboards[m.piece] &= ~toBB;
+        bitboards[m.piece] ^= toBB;
         bitboards[m.promotion] |= toBB;
+        mailbox[m.to] = m.promotion;
+        k ^= Zobrist.psq[m.piece][m.to] ^ Zobrist.psq[m.promotion][m.to];
+        score += PSQT[m.promotion][m.to] - PSQT[m.piece][m.to];
+        gamePhase += PHASE_WEIGHT[m.promotion % 6];
     }
+    occupancies[2] = occupancies[WHITE] | occupancies[BLACK];
 
     if (m.piece == WK) castling &= ~3;
     if (m.piece == BK) castling &= ~12;
@@ -403,30 +615,95 @@ bool Board::make_move(const Move& m) {
     if (m.piece == WP && m.to - m.from == 16) ep_square = m.from + 8;
     else if (m.piece == BP && m.from - m.to == 16) ep_square = m.from - 8;
     else ep_square = -1;
-    update_occupancies();
-    side = (side == WHITE ? BLACK : WHITE);
+    if (m.piece == WP || m.piece == BP || m.capture != PIECE_NB) halfmove = 0;
+    else ++halfmove;
+    side = them;
+
+    k ^= Zobrist.castling[castling] ^ Zobrist.side;
+    if (ep_capturable()) k ^= Zobrist.enpassant[ep_square % 8];
+    zobrist = k;
+    psq = score;
+    assert(zobrist == compute_key());
+    assert(psq == compute_psq());
+    assert(gamePhase == compute_phase());
     return true;
 }
 
-bool Board::square_attacked(int sq, Color by) const {
-    uint64_t target = 1ULL << sq;
-    uint64_t occ = occupancies[2];
-    if (by == WHITE) {
-        if (((bitboards[WP] << 7) & ~0x0101010101010101ULL) & target) return true;
-        if (((bitboards[WP] << 9) & ~0x8080808080808080ULL) & target) return true;
-        if (knightAttacks[sq] & bitboards[WN]) return true;
-        if (bishop_attacks(sq, occ) & (bitboards[WB] | bitboards[WQ])) return true;
-        if (rook_attacks(sq, occ) & (bitboards[WR] | bitboards[WQ])) return true;
-        if (kingAttacks[sq] & bitboards[WK]) return true;
-    } else {
-        if (((bitboards[BP] >> 7) & ~0x8080808080808080ULL) & target) return true;
-        if (((bitboards[BP] >> 9) & ~0x0101010101010101ULL) & target) return true;
-        if (knightAttacks[sq] & bitboards[BN]) return true;
-        if (bishop_attacks(sq, occ) & (bitboards[BB] | bitboards[BQ])) return true;
-        if (rook_attacks(sq, occ) & (bitboards[BR] | bitboards[BQ])) return true;
-        if (kingAttacks[sq] & bitboards[BK]) return true;
+void Board::unmake_move(Move m) {
+    assert(!history.empty());
+    const Undo& u = history.back();
+    side = (side == WHITE ? BLACK : WHITE);
+    Color us = side, them = (side == WHITE ? BLACK : WHITE);
+    const int from = m.from(), to = m.to();
+    uint64_t fromBB = 1ULL << from;
+    uint64_t toBB = 1ULL << to;
+
+    Piece piece = mailbox[to];
+    if (m.type() == PROMOTION) {
+        bitboards[piece] ^= toBB;
+        piece = make_piece(us, WP);
+        bitboards[piece] ^= toBB;
     }
-    return false;
+    bitboards[piece] ^= fromBB | toBB;
+    occupancies[us] ^= fromBB | toBB;
+    mailbox[to] = PIECE_NB;
+    mailbox[from] = piece;
+    if (m.type() == CASTLING) {
+        int rfrom, rto;
+        castling_rook_squares(to, rfrom, rto);
+        Piece rook = us == WHITE ? WR : BR;
+        uint64_t rookBB = (1ULL << rfrom) | (1ULL << rto);
+        bitboards[rook] ^= rookBB;
+        occupancies[us] ^= rookBB;
+        mailbox[rto] = PIECE_NB;
+        mailbox[rfrom] = rook;
+    }
+    if (u.captured != PIECE_NB) {
+        int capSq = m.type() == EN_PASSANT ? (us == WHITE ? to - 8 : to + 8) : to;
+        bitboards[u.captured] ^= 1ULL << capSq;
+        occupancies[them] ^= 1ULL << capSq;
+        mailbox[capSq] = u.captured;
+    }
+    occupancies[2] = occupancies[WHITE] | occupancies[BLACK];
+
+    castling = u.castling;
+    ep_square = u.ep_square;
+    halfmove = u.halfmove;
+    zobrist = u.key;
+    psq = u.psq;
+    gamePhase = u.phase;
+    history.pop_back();
+}
+
+void Board::make_null_move() {
+    assert(!checkers());
+    history.push_back({zobrist, psq, PIECE_NB, int16_t(halfmove), castling, int8_t(ep_square),
+                       uint8_t(gamePhase)});
+    uint64_t k = zobrist;
+    if (ep_capturable()) k ^= Zobrist.enpassant[ep_square % 8];
+    ep_square = -1;
+    ++halfmove;
+    side = side == WHITE ? BLACK : WHITE;
+    zobrist = k ^ Zobrist.side;
+    assert(zobrist == compute_key());
+}
+
+void Board::unmake_null_move() {
+    assert(!history.empty());
+    const Undo& u = history.back();
+    side = side == WHITE ? BLACK : WHITE;
+    ep_square = u.ep_square;
+    halfmove = u.halfmove;
+    zobrist = u.key;
+    history.pop_back();
+}
+
+bool Board::square_attacked(int sq, Color by) const {
+    return square_attacked(sq, by, occupancies[2]);
+}
+
+bool Board::square_attacked(int sq, Color by, uint64_t occ) const {
+    return by == WHITE ? attacked_by<WHITE>(sq, occ) : attacked_by<BLACK>(sq, occ);
 }
 
 bool Board::in_check(Color c) const {
@@ -434,53 +711,223 @@ bool Board::in_check(Color c) const {
     return square_attacked(kingSq, c == WHITE ? BLACK : WHITE);
 }
 
-std::vector<Board::Move> Board::generate_legal_moves() const {
-    std::vector<Move> moves;
-    auto pseudo = generate_moves();
-    for (const auto& mv : pseudo) {
-        Board copy = *this;
-        copy.make_move(mv);
-        if (!copy.in_check(side)) moves.push_back(mv);
-    }
-    return moves;
+uint64_t Board::checkers() const {
+    int ksq = ctz64(bitboards[make_piece(side, WK)]);
+    int enemy = side == WHITE ? BP : WP; // opponent pawn, other pieces follow
+    uint64_t occ = occupancies[2];
+    uint64_t queens = bitboards[enemy + 4];
+    return (pawnAttacks[side][ksq] & bitboards[enemy])
+         | (knightAttacks[ksq] & bitboards[enemy + 1])
+         | (bishop_attacks(ksq, occ) & (bitboards[enemy + 2] | queens))
+         | (rook_attacks(ksq, occ) & (bitboards[enemy + 3] | queens));
 }
 
-// ================= Magic bitboards =====================
+uint64_t Board::attackers_to(int sq, uint64_t occ) const {
+    const uint64_t queens = bitboards[WQ] | bitboards[BQ];
+    return (pawnAttacks[BLACK][sq] & bitboards[WP])
+         | (pawnAttacks[WHITE][sq] & bitboards[BP])
+         | (knightAttacks[sq] & (bitboards[WN] | bitboards[BN]))
+         | (bishop_attacks(sq, occ) & (bitboards[WB] | bitboards[BB] | queens))
+         | (rook_attacks(sq, occ) & (bitboards[WR] | bitboards[BR] | queens))
+         | (kingAttacks[sq] & (bitboards[WK] | bitboards[BK]));
+}
 
-static std::array<Magic, 64> rookMagics;
-static std::array<Magic, 64> bishopMagics;
+// Swap algorithm: the balance is tracked relative to threshold and the loop
+// stops as soon as the side to move can no longer change the outcome.
+// Removing a capturer from occ uncovers sliders behind it (x-rays).
+bool Board::see(Move m, int threshold) const {
+    if (m.type() != NORMAL) return threshold <= 0;
+    const int from = m.from(), to = m.to();
+    const Piece victim = mailbox[to];
+    int swap = (victim == PIECE_NB ? 0 : VAL_PIECE[victim % 6]) - threshold;
+    if (swap < 0) return false;
+    swap = VAL_PIECE[mailbox[from] % 6] - swap;
+    if (swap <= 0) return true;
 
-static uint64_t random_uint64() {
-    static uint64_t x = 88172645463325252ULL;
-    x ^= x << 7;  x ^= x >> 9;
-    return x;
+    uint64_t occ = occupancies[2] ^ (1ULL << from) ^ (1ULL << to);
+    uint64_t attackers = attackers_to(to, occ);
+    const uint64_t diagonal = bitboards[WB] | bitboards[BB] | bitboards[WQ] | bitboards[BQ];
+    const uint64_t straight = bitboards[WR] | bitboards[BR] | bitboards[WQ] | bitboards[BQ];
+    Color stm = side;
+    bool result = true;
+    for (;;) {
+        stm = Color(stm ^ 1);
+        attackers &= occ;
+        const uint64_t ours = attackers & occupancies[stm];
+        if (!ours) break;
+        result = !result;
+
+        // Least valuable attacker; the king may only take when nothing
+        // can recapture
+        int type = WP;
+        uint64_t bb = 0;
+        for (; type < WK; ++type)
+            if ((bb = ours & bitboards[make_piece(stm, type)])) break;
+        if (type == WK)
+            return (attackers & ~occupancies[stm]) ? !result : result;
+        if ((swap = VAL_PIECE[type] - swap) < int(result)) break;
+        occ ^= bb & (0 - bb);
+        if (type == WP || type == WB || type == WQ)
+            attackers |= bishop_attacks(to, occ) & diagonal;
+        if (type == WR || type == WQ)
+            attackers |= rook_attacks(to, occ) & straight;
+    }
+    return result;
 }
 
+// Tests a pseudo-legal move for king safety without playing it: the king
+// square is checked for enemy attackers against the occupancy after the move,
+// ignoring whatever the move captures. Castling also needs the origin and
+// transit squares to be safe.
+bool Board::is_legal(Move m) const {
+    Color us = side;
+    Piece ourKing = us == WHITE ? WK : BK;
+    int enemy = us == WHITE ? BP : WP; // opponent pawn, other pieces follow
+    uint64_t fromBB = 1ULL << m.from();
+    uint64_t toBB = 1ULL << m.to();
+    uint64_t occ = (occupancies[2] ^ fromBB) | toBB;
+    uint64_t removed = toBB;
+    if (m.type() == EN_PASSANT) {
+        removed = us == WHITE ? toBB >> 8 : toBB << 8;
+        occ ^= removed;
+    } else if (m.type() == CASTLING) {
+        // no castling out of or through check
+        Color them = Color(us ^ 1);
+        if (square_attacked(m.from(), them) || square_attacked((m.from() + m.to()) / 2, them))
+            return false;
+        int rfrom, rto;
+        castling_rook_squares(m.to(), rfrom, rto);
+        occ = (occ ^ (1ULL << rfrom)) | (1ULL << rto);
+    }
+    int ksq = mailbox[m.from()] == ourKing ? m.to() : ctz64(bitboards[ourKing]);
+    uint64_t enemies = occupancies[us ^ 1] & ~removed;
+    uint64_t queens = bitboards[enemy + 4];
+    if (pawnAttacks[us][ksq] & bitboards[enemy] & enemies) return false;
+    if (knightAttacks[ksq] & bitboards[enemy + 1] & enemies) return false;
+    if (bishop_attacks(ksq, occ) & (bitboards[enemy + 2] | queens) & enemies) return false;
+    if (rook_attacks(ksq, occ) & (bitboards[enemy + 3] | queens) & enemies) return false;
+    if (kingAttacks[ksq] & bitboards[enemy + 5]) return false;
+    return true;
+}
 
+bool Board::is_pseudo_legal(Move m) const {
+    const int from = m.from(), to = m.to();
+    const Piece pc = mailbox[from];
+    if (pc == PIECE_NB || pc / 6 != side || from == to) return false;
+    // only promotions carry a promotion piece
+    if (m.type() != PROMOTION && m.promotion_type() != WN) return false;
+    const uint64_t toBB = 1ULL << to;
+    const int type = pc % 6;
 
+    if (m.type() == CASTLING) {
+        const int kfrom = side == WHITE ? 4 : 60;
+        if (type != WK || from != kfrom || (to != kfrom + 2 && to != kfrom - 2)) return false;
+        const bool kingSide = to == kfrom + 2;
+        const int right = (kingSide ? 1 : 2) << (side == WHITE ? 0 : 2);
+        const uint64_t path = (kingSide ? 0x60ULL : 0x0EULL) << (kfrom - 4);
+        return (castling & right) && !(occupancies[2] & path);
+    }
+    if (occupancies[side] & toBB) return false;
 
-static uint64_t knight_mask(int sq) {
-    int r = sq / 8, f = sq % 8;
-    const int offsets[8][2] = {{1,2},{2,1},{-1,2},{-2,1},{1,-2},{2,-1},{-1,-2},{-2,-1}};
-    uint64_t mask = 0;
-    for(auto& o : offsets){
-        int r1 = r + o[0];
-        int f1 = f + o[1];
-        if(r1>=0 && r1<8 && f1>=0 && f1<8) mask |= 1ULL << (r1*8+f1);
+    if (type == WP) {
+        const int up = side == WHITE ? 8 : -8;
+        const bool lastRank = to / 8 == (side == WHITE ? 7 : 0);
+        if (lastRank != (m.type() == PROMOTION)) return false;
+        if (m.type() == EN_PASSANT) return to == ep_square && (pawnAttacks[side][from] & toBB);
+        if (pawnAttacks[side][from] & toBB) return occupancies[side ^ 1] & toBB;
+        if (to == from + up) return !(occupancies[2] & toBB);
+        if (to == from + 2 * up)
+            return from / 8 == (side == WHITE ? 1 : 6)
+                && !(occupancies[2] & (toBB | 1ULL << (from + up)));
+        return false;
     }
-    return mask;
-}
+    if (m.type() != NORMAL) return false;
 
-static uint64_t king_mask(int sq) {
-    int r = sq / 8, f = sq % 8;
-    const int offsets[8][2] = {{1,0},{1,1},{0,1},{-1,1},{-1,0},{-1,-1},{0,-1},{1,-1}};
-    uint64_t mask = 0;
-    for(auto& o : offsets){
-        int r1 = r + o[0];
-        int f1 = f + o[1];
-        if(r1>=0 && r1<8 && f1>=0 && f1<8) mask |= 1ULL << (r1*8+f1);
+    uint64_t attacks = 0;
+    switch (type) {
+    case WN: attacks = knightAttacks[from]; break;
+    case WB: attacks = bishop_attacks(from, occupancies[2]); break;
+    case WR: attacks = rook_attacks(from, occupancies[2]); break;
+    case WQ: attacks = bishop_attacks(from, occupancies[2]) | rook_attacks(from, occupancies[2]); break;
+    default: attacks = kingAttacks[from]; break;
     }
-    return mask;
+    return attacks & toBB;
+}
+
+void Board::generate_legal_moves(MoveList& list) const {
+    list.clear();
+    if (checkers()) generate<EVASIONS>(list);
+    else generate<NON_EVASIONS>(list);
+}
+
+std::vector<Move> Board::generate_moves() const {
+    MoveList list;
+    generate_moves(list);
+    return std::vector<Move>(list.begin(), list.end());
+}
+
+std::vector<Move> Board::generate_legal_moves() const {
+    MoveList list;
+    generate_legal_moves(list);
+    return std::vector<Move>(list.begin(), list.end());
+}
+
+// ================= Magic bitboards =====================
+
+// Magic multipliers for the occupancy masks below, found offline by a
+// fixed-shift search. ((occ & mask) * magic) >> (64 - popcount(mask)) is a
+// collision-free index into the square's slice of sliderAttacks.
+constexpr uint64_t RookMagicNumbers[64] = {
+    0x1180002040008210ULL, 0x80C0100020004000ULL, 0x0100100841002000ULL, 0x0100040810010020ULL,
+    0x0900040801001002ULL, 0x0800840802204010ULL, 0x0880088002002100ULL, 0x010002894021000AULL,
+    0x500080008040002CULL, 0x0440C04000201000ULL, 0x0041001100200040ULL, 0x0400800800801001ULL,
+    0x0040800800040280ULL, 0x0004800C00060080ULL, 0x4506002104420048ULL, 0x0040800100004080ULL,
+    0x8000208000400080ULL, 0x2040828020004000ULL, 0x010080801000200AULL, 0x0408018008D00080ULL,
+    0x0114008008000482ULL, 0x08D2008002800400ULL, 0xC208840081100208ULL, 0x8040020019108044ULL,
+    0x0000400080008020ULL, 0x0000500140002000ULL, 0x0000100080802000ULL, 0x8020100080800800ULL,
+    0x0408000880040080ULL, 0x3200040080020080ULL, 0x0109010080800200ULL, 0x0024010200009044ULL,
+    0x0080400084800020ULL, 0x6140400105002080ULL, 0x0C00862006801000ULL, 0x2048000880801000ULL,
+    0x4100800402802800ULL, 0x0012800200800400ULL, 0x0081000409003200ULL, 0x8018010082002044ULL,
+    0x000073C009808000ULL, 0x4104200050044008ULL, 0x0001004020010011ULL, 0x018020400A020010ULL,
+    0x0680040008008080ULL, 0x0012000804020010ULL, 0x0E00020108040010ULL, 0x202020498C020009ULL,
+    0x00404D0160800100ULL, 0x4000220099004200ULL, 0x0090002000881080ULL, 0x0000808800100480ULL,
+    0x44008C0080380180ULL, 0x4182000804110200ULL, 0x0520418208102400ULL, 0x480010610C008200ULL,
+    0x040043020011A082ULL, 0x0400160041812302ULL, 0x405020001019C301ULL, 0x0010000805209101ULL,
+    0x1002007408201006ULL, 0x08020004C1081002ULL, 0x2000022110008804ULL, 0x820400250B80C402ULL,
+};
+
+constexpr uint64_t BishopMagicNumbers[64] = {
+    0x2288123004490100ULL, 0x0910120840408602ULL, 0x2008022420200000ULL, 0x440404009404840DULL,
+    0x0004042000000024ULL, 0x9211100804012450ULL, 0x0001010802408000ULL, 0x1400150082104041ULL,
+    0x0008112102008608ULL, 0x0100100280810204ULL, 0x0102088094048004ULL, 0x20C0482080206014ULL,
+    0x0020020210088213ULL, 0x0008020110082410ULL, 0x0004004410480800ULL, 0x0005020100884404ULL,
+    0x8820001004810800ULL, 0x1033001022020C04ULL, 0x0010004800802008ULL, 0x00040012C4028111ULL,
+    0x0002828400A04200ULL, 0x0400800100A00100ULL, 0x8800800200900820ULL, 0x2010800900A80140ULL,
+    0x20024A2040104428ULL, 0x0008604018094100ULL, 0x0004110C10004082ULL, 0x0090040000401020ULL,
+    0x4A80840044802000ULL, 0x060C820400880400ULL, 0x8801004141141004ULL, 0x003050400D0C0200ULL,
+    0x0130042040040804ULL, 0x0424103810051100ULL, 0x0013441001020224ULL, 0x151C400A00002200ULL,
+    0x8388020401001010ULL, 0x0000870900061000ULL, 0x0022042048590808ULL, 0x0242508600082200ULL,
+    0x0882080540004401ULL, 0x84410110B0220200ULL, 0x4409021082005001ULL, 0x1A02204208000080ULL,
+    0x4000480100410400ULL, 0x6401120802000C40ULL, 0x0028810424062080ULL, 0x014C010E06010124ULL,
+    0x0214020104211410ULL, 0x1800490401200820ULL, 0x0120504424040200ULL, 0x0F00001042020225ULL,
+    0x0000001020220848ULL, 0x300008A0080090C0ULL, 0x08082028B0810406ULL, 0x0408014104110000ULL,
+    0x0002004042282010ULL, 0x4900402088041002ULL, 0x0020880500611002ULL, 0x0400053840840440ULL,
+    0x048400081002020AULL, 0x0880801003101100ULL, 0x8028100208410400ULL, 0x11900210004A0440ULL,
+};
+
+// Rook slices take 102400 entries and bishop slices 5248; all of them live
+// back to back in one table.
+constexpr size_t SLIDER_TABLE_SIZE = 102400 + 5248;
+static uint64_t sliderAttacks[SLIDER_TABLE_SIZE];
+static std::array<Magic, 64> rookMagics;
+static std::array<Magic, 64> bishopMagics;
+static SliderBackend sliderBackend = SliderBackend::MAGIC;
+
+static inline uint64_t slider_index(const Magic& m, uint64_t occ) {
+#if CT2_BMI2_ASM
+    if (sliderBackend == SliderBackend::PEXT) return pext64_bmi2(occ, m.mask);
+#endif
+    return ((occ & m.mask) * m.magic) >> m.shift;
 }
 
 static uint64_t rook_mask(int sq) {
@@ -526,92 +973,101 @@ static uint64_t sliding_attack(bool bishop, int sq, uint64_t occ) {
     return attacks;
 }
 
-static void init_magic_array(bool bishop, std::array<Magic,64>& magics) {
+// Fills the slices of one piece type starting at table; returns the end
+static uint64_t* init_magic_array(bool bishop, const uint64_t (&numbers)[64],
+                                  std::array<Magic,64>& magics, uint64_t* table) {
     for (int sq=0; sq<64; ++sq) {
-        Magic m{};
+        Magic& m = magics[sq];
         m.mask = bishop ? bishop_mask(sq) : rook_mask(sq);
-        int bits = popcount64(m.mask);
-        m.shift = 64 - bits;
-        size_t size = 1ULL << bits;
-        m.attacks.assign(size, 0);
-
-        std::vector<uint64_t> occupancies(size);
-        std::vector<uint64_t> references(size);
+        m.magic = numbers[sq];
+        m.shift = 64 - popcount64(m.mask);
+        m.attacks = table;
 
         uint64_t b=0;
-        for (size_t i=0;i<size;++i) {
-            occupancies[i]=b;
-            references[i]=sliding_attack(bishop,sq,b);
-            b=(b-m.mask)&m.mask;
-        }
+        do {
+            uint64_t idx = sliderBackend == SliderBackend::PEXT
+                ? pext64(b, m.mask) : (b * m.magic) >> m.shift;
+            uint64_t attacks = sliding_attack(bishop, sq, b);
+            // Slider attack sets are never empty, so 0 marks an unused slot
+            assert(m.attacks[idx] == 0 || m.attacks[idx] == attacks);
+            m.attacks[idx] = attacks;
+            b = (b - m.mask) & m.mask;
+        } while (b);
+        table += 1ULL << (64 - m.shift);
+    }
+    return table;
+}
 
-        bool found=false;
-        for(int k=0;k<100000 && !found;++k){
-            uint64_t magic=random_uint64()&random_uint64()&random_uint64();
-
-            if(popcount64((magic*m.mask)>>56) < 6) continue;
-            std::vector<uint64_t> used(size, 0xFFFFFFFFFFFFFFFFULL);
-            bool fail=false;
-            for(size_t i=0;i<size && !fail;++i){
-                uint64_t idx=(occupancies[i]*magic)>>m.shift;
-                if(used[idx]==0xFFFFFFFFFFFFFFFFULL) used[idx]=references[i];
-                else if(used[idx]!=references[i]) fail=true;
-            }
-            if(!fail){
-                m.magic=magic;
-                for(size_t i=0;i<size;++i){
-                    uint64_t idx=(occupancies[i]*magic)>>m.shift;
-                    m.attacks[idx]=references[i];
-                }
-                found=true;
-            }
-        }
-        if(!found){
-            // fallback: simple attacks without magic
-            for(size_t i=0;i<size;++i){
-                m.attacks[i]=references[i];
-            }
-        }
-        magics[sq]=m;
+bool cpu_has_fast_pext() {
+#if CT2_BMI2_ASM
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx) || eax < 7) return false;
+    const bool amd = ebx == 0x68747541; // "AuthenticAMD"
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    if (!(ebx & (1u << 8))) return false; // BMI2
+    if (amd) {
+        // Before Zen 3 (family 19h) pext is microcoded and slower than a
+        // magic multiply
+        __cpuid(1, eax, ebx, ecx, edx);
+        unsigned family = ((eax >> 8) & 0xF) + ((eax >> 20) & 0xFF);
+        if (family < 0x19) return false;
     }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void init_magics(SliderBackend backend) {
+    assert(backend == SliderBackend::MAGIC || cpu_has_fast_pext());
+    sliderBackend = backend;
+    std::fill(std::begin(sliderAttacks), std::end(sliderAttacks), 0);
+    uint64_t* end = init_magic_array(false, RookMagicNumbers, rookMagics, sliderAttacks);
+    end = init_magic_array(true, BishopMagicNumbers, bishopMagics, end);
+    assert(end == sliderAttacks + SLIDER_TABLE_SIZE);
+    (void)end;
 }
 
 void init_magics() {
-    init_magic_array(false, rookMagics);
-    init_magic_array(true, bishopMagics);
+    init_magics(cpu_has_fast_pext() ? SliderBackend::PEXT : SliderBackend::MAGIC);
 }
 
+SliderBackend slider_backend() { return sliderBackend; }
+
 uint64_t bishop_attacks(int sq, uint64_t occ) {
     const Magic& m = bishopMagics[sq];
-    if(m.magic == 0) { // fallback when magic generation failed
-        return sliding_attack(true, sq, occ);
-    }
-    uint64_t occMask = occ & m.mask;
-    uint64_t idx = (occMask * m.magic) >> m.shift;
-    if(idx < m.attacks.size()) return m.attacks[idx];
-    return 0ULL;
+    return m.attacks[slider_index(m, occ)];
 }
 
 uint64_t rook_attacks(int sq, uint64_t occ) {
     const Magic& m = rookMagics[sq];
-    if(m.magic == 0) { // fallback when magic generation failed
-        return sliding_attack(false, sq, occ);
-    }
-    uint64_t occMask = occ & m.mask;
-    uint64_t idx = (occMask * m.magic) >> m.shift;
-    if(idx < m.attacks.size()) return m.attacks[idx];
-    return 0ULL;
+    return m.attacks[slider_index(m, occ)];
 }
 
-static void init_leaper_attacks() {
-    for(int sq=0; sq<64; ++sq) {
-        knightAttacks[sq] = knight_mask(sq);
-        kingAttacks[sq] = king_mask(sq);
+static void init_line_tables() {
+    static const int dirs[8][2] = {{1,0},{-1,0},{0,1},{0,-1},{1,1},{1,-1},{-1,1},{-1,-1}};
+    for (int sq = 0; sq < 64; ++sq) {
+        int r = sq / 8, f = sq % 8;
+        for (int d = 0; d < 8; ++d) {
+            int dr = dirs[d][0], df = dirs[d][1];
+            // full line through sq along this direction, both ways
+            uint64_t line = 1ULL << sq;
+            for (int s = -1; s <= 1; s += 2)
+                for (int r1 = r + s*dr, f1 = f + s*df; r1>=0 && r1<8 && f1>=0 && f1<8; r1 += s*dr, f1 += s*df)
+                    line |= 1ULL << (r1*8+f1);
+            uint64_t between = 0;
+            for (int r1 = r + dr, f1 = f + df; r1>=0 && r1<8 && f1>=0 && f1<8; r1 += dr, f1 += df) {
+                int sq1 = r1*8+f1;
+                betweenBB[sq][sq1] = between;
+                lineBB[sq][sq1] = line;
+                between |= 1ULL << sq1;
+            }
+        }
     }
 }
 
 void init_tables() {
-    init_leaper_attacks();
+    init_line_tables();
     init_magics();
 }
 
@@ -16,11 +16,84 @@ enum Piece {
 
 enum Color { WHITE, BLACK, COLOR_NB };
 
+constexpr int MAX_MOVES = 256;
+
+// Move generation stages. CAPTURES includes all promotions; CAPTURES and
+// QUIETS together give every move (NON_EVASIONS). EVASIONS is only valid
+// when the side to move is in check.
+enum GenType { CAPTURES, QUIETS, QUIET_CHECKS, EVASIONS, NON_EVASIONS };
+
+constexpr Piece make_piece(Color c, int pieceType) { return Piece(c * 6 + pieceType); }
+
+enum MoveType : uint16_t {
+    NORMAL,
+    PROMOTION  = 1 << 14,
+    EN_PASSANT = 2 << 14,
+    CASTLING   = 3 << 14
+};
+
+// Packed 16-bit move: bits 0-5 origin, 6-11 destination, 12-13 promotion
+// piece type minus one (knight..queen), 14-15 MoveType. Moving and captured
+// pieces are not stored; Board::decode recovers them from the mailbox.
+class Move {
+public:
+    Move() = default;
+    constexpr Move(int from, int to) : data(uint16_t(from | (to << 6))) {}
+    constexpr Move(int from, int to, MoveType type, int promoType = WN)
+        : data(uint16_t(from | (to << 6) | ((promoType - WN) << 12) | type)) {}
+
+    static constexpr Move none() { return Move(0, 0); }
+    static constexpr Move from_raw(uint16_t raw) { Move m = none(); m.data = raw; return m; }
+
+    constexpr int from() const { return data & 0x3F; }
+    constexpr int to() const { return (data >> 6) & 0x3F; }
+    constexpr MoveType type() const { return MoveType(data & (3 << 14)); }
+    // Piece type (WN..WQ) of a PROMOTION move
+    constexpr int promotion_type() const { return ((data >> 12) & 3) + WN; }
+    constexpr uint16_t raw() const { return data; }
+
+    constexpr bool operator==(Move m) const { return data == m.data; }
+    constexpr bool operator!=(Move m) const { return data != m.data; }
+
+private:
+    uint16_t data;
+};
+
+// Unpacked view of a move against a particular position
+struct DecodedMove {
+    int from;
+    int to;
+    Piece piece;
+    Piece capture;
+    Piece promotion;
+    bool is_ep;
+    bool is_castling;
+};
+
+// Fixed-capacity move list living on the stack, with a score slot per move
+// for ordering
+struct MoveList {
+    std::array<Move, MAX_MOVES> moves;
+    std::array<int, MAX_MOVES> scores;
+    int count = 0;
+
+    void push_back(Move m) { moves[count++] = m; }
+    void clear() { count = 0; }
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+    Move& operator[](int i) { return moves[i]; }
+    Move operator[](int i) const { return moves[i]; }
+    Move* begin() { return moves.data(); }
+    Move* end() { return moves.data() + count; }
+    const Move* begin() const { return moves.data(); }
+    const Move* end() const { return moves.data() + count; }
+};
+
 struct Magic {
     uint64_t mask;
     uint64_t magic;
     int shift;
-    std::vector<uint64_t> attacks;
+    uint64_t* attacks; // this square's slice of the shared attack table
 };
 
 class Board {
@@ -29,40 +102,100 @@ public:
     bool loadFEN(const std::string& fen);
     std::string getFEN() const;
 
-    struct Move {
-        int from;
-        int to;
-        Piece piece;
-        Piece capture;
-        Piece promotion;
-        bool is_ep;
-        bool is_castling;
+    // State that make_move cannot recover from the move itself
+    struct Undo {
+        uint64_t key;
+        int32_t psq;
+        Piece captured;
+        int16_t halfmove;
+        uint8_t castling;
+        int8_t ep_square;
+        uint8_t phase;
     };
 
+    // Appends the legal moves of the given stage to list
+    template<GenType Type> void generate(MoveList& list) const;
+    void generate_legal_moves(MoveList& list) const;
+    // Pseudo-legal moves; filter with is_legal()
+    void generate_moves(MoveList& list) const;
+    // Allocating wrappers, convenient for tests
     std::vector<Move> generate_moves() const;
     std::vector<Move> generate_legal_moves() const;
+    bool is_legal(Move m) const;
+    // Whether m could have been generated here, king safety aside. Moves
+    // from elsewhere (table, killers) must pass this before is_legal().
+    bool is_pseudo_legal(Move m) const;
     bool square_attacked(int sq, Color by) const;
+    bool square_attacked(int sq, Color by, uint64_t occ) const;
     bool in_check(Color c) const;
-    bool make_move(const Move& m);
+    uint64_t checkers() const; // enemy pieces giving check to the side to move
+    // Pieces of both colours attacking sq, with sliders seeing through occ
+    uint64_t attackers_to(int sq, uint64_t occ) const;
+    // Static exchange evaluation: whether the capture sequence started by m
+    // on its destination wins at least threshold centipawns for the mover,
+    // each side recapturing with its least valuable piece and free to stop.
+    // Pins are ignored; castling, en passant and promotions count as even.
+    bool see(Move m, int threshold = 0) const;
+    bool make_move(Move m);
+    void unmake_move(Move m);
+    // Passes the turn; only valid when the side to move is not in check
+    void make_null_move();
+    void unmake_null_move();
+    DecodedMove decode(Move m) const;
+
+    // Zobrist hash of the position, maintained incrementally by make_move
+    uint64_t key() const { return zobrist; }
+    uint64_t compute_key() const;
+    // Material and piece-square sum from white's point of view as a packed
+    // midgame/endgame Score (see psqt.h), kept up to date by make_move
+    int32_t psq_score() const { return psq; }
+    int32_t compute_psq() const;
+    // Non-pawn material weighted by PHASE_WEIGHT, also incremental
+    int phase() const { return gamePhase; }
+    int compute_phase() const;
 
     uint64_t pieceBB(Piece p) const { return bitboards[p]; }
+    Piece piece_on(int sq) const { return mailbox[sq]; } // PIECE_NB if empty
     uint64_t occupancyBB(Color c) const { return occupancies[c]; }
     uint64_t occupancyBB() const { return occupancies[2]; }
     Color side_to_move() const { return side; }
     int ep_square_sq() const { return ep_square; }
+    int halfmove_clock() const { return halfmove; }
+    // Any knight, bishop, rook or queen; without them zugzwang is likely
+    bool has_non_pawn_material(Color c) const {
+        return occupancies[c] & ~bitboards[make_piece(c, WP)] & ~bitboards[make_piece(c, WK)];
+    }
 
 private:
     std::array<uint64_t, PIECE_NB> bitboards{};
     std::array<uint64_t, 3> occupancies{}; // white, black, both
+    std::array<Piece, 64> mailbox;
     Color side;
     uint8_t castling; // KQkq = 1|2|4|8
     int ep_square;    // -1 if none
+    int halfmove;
+    uint64_t zobrist;
+    int32_t psq;
+    int gamePhase;
+    std::vector<Undo> history;
 
-    void update_occupancies();
+    bool ep_capturable() const;
+    template<Color Us, GenType Type, bool Legal> void generate_all(MoveList& list) const;
+    template<Color By> bool attacked_by(int sq, uint64_t occ) const;
 };
 
-// Magic bitboard related
+// Coordinate notation: "e4", and "e7e8q" for moves
+std::string sq_to_str(int sq);
+std::string move_to_str(Move m);
+
+// Slider attack lookup. Both backends use the same per-square slices of one
+// table; PEXT indexes them with a single pext instead of a magic multiply.
+enum class SliderBackend { MAGIC, PEXT };
+bool cpu_has_fast_pext(); // BMI2 present and pext not microcoded
+// Picks PEXT when the CPU has fast BMI2, magics otherwise
 void init_magics();
+void init_magics(SliderBackend backend); // PEXT requires cpu_has_fast_pext()
+SliderBackend slider_backend();
 void init_tables();
 uint64_t bishop_attacks(int sq, uint64_t occ);
 uint64_t rook_attacks(int sq, uint64_t occ);
@@ -0,0 +1,18 @@
+#include "eval.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace ct2 {
+
+// Material and piece-square terms are kept by the board as pieces move, for
+// the midgame and the endgame at once; the phase blends the two
+int evaluate(const Board& b) {
+    const Score score = b.psq_score();
+    assert(score == b.compute_psq());
+    const int phase = std::min(b.phase(), PHASE_MIDGAME);
+    const int v = (mg_value(score) * phase + eg_value(score) * (PHASE_MIDGAME - phase)) / PHASE_MIDGAME;
+    return b.side_to_move() == WHITE ? v : -v;
+}
+
+} // namespace ct2
@@ -0,0 +1,14 @@
+#ifndef CT2_EVAL_H
+#define CT2_EVAL_H
+
+#include "board.h"
+#include "psqt.h"
+
+namespace ct2 {
+
+// Static evaluation in centipawns from the side to move's point of view
+int evaluate(const Board& b);
+
+} // namespace ct2
+
+#endif // CT2_EVAL_H
@@ -1,8 +1,76 @@
+#include "bench.h"
 #include "board.h"
+#include "perft.h"
+#include "search.h"
 #include "uci.h"
 
-int main() {
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+static const char* START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// ct2 perft <depth> [--fen "<fen>"] [--threads N] [--hash MB]
+static int perft_main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "usage: ct2 perft <depth> [--fen \"<fen>\"] [--threads N] [--hash MB]" << std::endl;
+        return 1;
+    }
+    int depth = std::atoi(argv[2]);
+    std::string fen = START_FEN;
+    ct2::PerftOptions opts;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "--fen") fen = argv[i + 1];
+        else if (opt == "--threads") opts.threads = std::atoi(argv[i + 1]);
+        else if (opt == "--hash") opts.hashMB = std::strtoull(argv[i + 1], nullptr, 10);
+        else {
+            std::cerr << "unknown option " << opt << std::endl;
+            return 1;
+        }
+    }
+
+    ct2::Board board;
+    if (!board.loadFEN(fen)) {
+        std::cerr << "invalid FEN: " << fen << std::endl;
+        return 1;
+    }
+    ct2::perft_report(board, depth, opts, std::cout);
+    return 0;
+}
+
+// ct2 bench [depth] [maxThreads] [--no-nmp] [--no-lmr] [--no-rfp] [--no-lmp] [--no-fp]
+static int bench_main(int argc, char** argv) {
+    int depth = 6;
+    int maxThreads = int(std::max(1u, std::thread::hardware_concurrency()));
+    ct2::SearchFeatures features;
+    int positional = 0;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--no-nmp") features.nullMove = false;
+        else if (arg == "--no-lmr") features.lateMoveReductions = false;
+        else if (arg == "--no-rfp") features.reverseFutility = false;
+        else if (arg == "--no-lmp") features.lateMovePruning = false;
+        else if (arg == "--no-fp") features.futilityPruning = false;
+        else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "unknown option " << arg << std::endl;
+            return 1;
+        } else if (positional++ == 0) depth = std::atoi(arg.c_str());
+        else maxThreads = std::atoi(arg.c_str());
+    }
+    ct2::set_search_features(features);
+    ct2::run_bench(depth, std::max(1, maxThreads), std::cout);
+    return 0;
+}
+
+int main(int argc, char** argv) {
     ct2::init_tables();
+    if (argc > 1 && std::string(argv[1]) == "perft")
+        return perft_main(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "bench")
+        return bench_main(argc, argv);
     ct2::Board board;
     ct2::uci_loop(board);
     return 0;
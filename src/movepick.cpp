@@ -0,0 +1,192 @@
+#include "movepick.h"
+#include "eval.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace ct2 {
+
+namespace {
+
+// Evasions that capture are tried before any quiet evasion. Quiet evasions
+// are scored by history, which must stay below this.
+constexpr int EVASION_CAPTURE_BONUS = 1 << 20;
+
+} // namespace
+
+bool is_quiet(const Board& b, Move m) {
+    return b.piece_on(m.to()) == PIECE_NB && m.type() != PROMOTION && m.type() != EN_PASSANT;
+}
+
+int capture_score(const Board& b, Move m) {
+    const DecodedMove mv = b.decode(m);
+    int score = 0;
+    if (mv.capture != PIECE_NB)
+        score += 10 * VAL_PIECE[mv.capture % 6] - VAL_PIECE[mv.piece % 6];
+    if (mv.promotion != PIECE_NB)
+        score += VAL_PIECE[mv.promotion % 6];
+    return score;
+}
+
+MovePicker::MovePicker(const Board& b, Move ttm, const Move* killers, Move counterMove,
+                       const ButterflyHistory& hist)
+    : board(b), history(&hist), ttMove(ttm) {
+    const bool inCheck = b.checkers() != 0;
+    stage = inCheck ? EVASION_TT : MAIN_TT;
+    if (!valid_special(ttMove)) ttMove = Move::none();
+    if (!inCheck) {
+        refutations[0] = killers[0];
+        refutations[1] = killers[1];
+        refutations[2] = counterMove;
+    }
+}
+
+MovePicker::MovePicker(const Board& b, Move ttm, const ButterflyHistory& hist)
+    : board(b), history(&hist), ttMove(ttm) {
+    const bool inCheck = b.checkers() != 0;
+    stage = inCheck ? EVASION_TT : QSEARCH_TT;
+    if (!valid_special(ttMove) || (!inCheck && is_quiet(b, ttMove))) ttMove = Move::none();
+}
+
+// Moves not taken from the generator: the TT move, killers and countermove
+// may come from a different position
+bool MovePicker::valid_special(Move m) const {
+    return m != Move::none() && board.is_pseudo_legal(m) && board.is_legal(m);
+}
+
+void MovePicker::score_captures(int begin, int end) {
+    for (int i = begin; i < end; ++i) moves.scores[i] = capture_score(board, moves[i]);
+}
+
+void MovePicker::score_quiets(int begin, int end) {
+    const Color us = board.side_to_move();
+    for (int i = begin; i < end; ++i)
+        moves.scores[i] = (*history)[us][moves[i].from()][moves[i].to()];
+}
+
+void MovePicker::score_evasions(int begin, int end) {
+    const Color us = board.side_to_move();
+    for (int i = begin; i < end; ++i) {
+        Move m = moves[i];
+        moves.scores[i] = is_quiet(board, m) ? (*history)[us][m.from()][m.to()]
+                                             : EVASION_CAPTURE_BONUS + capture_score(board, m);
+    }
+}
+
+int MovePicker::select_best(int end) {
+    int best = cur;
+    for (int i = cur + 1; i < end; ++i)
+        if (moves.scores[i] > moves.scores[best]) best = i;
+    std::rotate(moves.moves.begin() + cur, moves.moves.begin() + best, moves.moves.begin() + best + 1);
+    std::rotate(moves.scores.begin() + cur, moves.scores.begin() + best, moves.scores.begin() + best + 1);
+    return cur;
+}
+
+bool MovePicker::is_refutation(Move m) const {
+    return m == refutations[0] || m == refutations[1] || m == refutations[2];
+}
+
+Move MovePicker::next_move() {
+    switch (stage) {
+    case MAIN_TT:
+    case EVASION_TT:
+    case QSEARCH_TT:
+        ++stage;
+        if (ttMove != Move::none()) return ttMove;
+        return next_move();
+
+    case CAPTURE_INIT:
+    case QCAPTURE_INIT:
+        board.generate<CAPTURES>(moves);
+        captureEnd = moves.count;
+        score_captures(0, captureEnd);
+        ++stage;
+        return next_move();
+
+    case GOOD_CAPTURE:
+        while (cur < captureEnd) {
+            Move m = moves[select_best(captureEnd)];
+            if (m == ttMove) {
+                ++cur;
+            } else if (!board.see(m)) {
+                std::swap(moves.moves[cur], moves.moves[badEnd]);
+                std::swap(moves.scores[cur], moves.scores[badEnd]);
+                ++badEnd;
+                ++cur;
+            } else {
+                ++cur;
+                return m;
+            }
+        }
+        ++stage;
+        [[fallthrough]];
+
+    case REFUTATION:
+        while (!skipQuiets && refutationCount < 3) {
+            Move& m = refutations[refutationCount++];
+            bool duplicate = false;
+            for (int i = 0; i < refutationCount - 1; ++i) duplicate |= refutations[i] == m;
+            if (m == ttMove || duplicate || !valid_special(m) || !is_quiet(board, m)) {
+                m = Move::none();
+                continue;
+            }
+            return m;
+        }
+        ++stage;
+        [[fallthrough]];
+
+    case QUIET_INIT:
+        cur = captureEnd;
+        if (!skipQuiets) {
+            board.generate<QUIETS>(moves);
+            score_quiets(captureEnd, moves.count);
+        }
+        ++stage;
+        [[fallthrough]];
+
+    case QUIET:
+        while (!skipQuiets && cur < moves.count) {
+            Move m = moves[select_best(moves.count)];
+            ++cur;
+            if (m != ttMove && !is_refutation(m)) return m;
+        }
+        cur = 0;
+        ++stage;
+        [[fallthrough]];
+
+    case BAD_CAPTURE:
+        if (cur < badEnd) {
+            select_best(badEnd);
+            return moves[cur++];
+        }
+        stage = DONE;
+        return Move::none();
+
+    case EVASION_INIT:
+        board.generate<EVASIONS>(moves);
+        score_evasions(0, moves.count);
+        ++stage;
+        [[fallthrough]];
+
+    case EVASION:
+        while (cur < moves.count) {
+            Move m = moves[select_best(moves.count)];
+            ++cur;
+            if (m != ttMove) return m;
+        }
+        stage = DONE;
+        return Move::none();
+
+    case QCAPTURE:
+        while (cur < captureEnd) {
+            Move m = moves[select_best(captureEnd)];
+            ++cur;
+            if (m != ttMove) return m;
+        }
+        stage = DONE;
+        return Move::none();
+    }
+    return Move::none();
+}
+
+} // namespace ct2
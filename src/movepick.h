@@ -0,0 +1,76 @@
+#ifndef CT2_MOVEPICK_H
+#define CT2_MOVEPICK_H
+
+#include "board.h"
+
+#include <cstdint>
+
+namespace ct2 {
+
+// Quiet move history indexed by side to move, origin and destination
+using ButterflyHistory = int16_t[COLOR_NB][64][64];
+
+// Neither a capture nor a promotion
+bool is_quiet(const Board& b, Move m);
+
+// MVV-LVA order for captures and promotions
+int capture_score(const Board& b, Move m);
+
+// Hands out the legal moves of a node one at a time, best first. Later
+// stages are only generated once reached, so a cutoff on the TT move or a
+// good capture never pays for generating and scoring the quiet moves.
+//
+// Main search order: TT move, captures that do not lose material by static
+// exchange evaluation, killers and countermove, quiets by history, then the
+// losing captures. In check all evasions are scored together after the TT
+// move. Out of check the quiescence picker only returns the TT move and
+// captures.
+class MovePicker {
+public:
+    MovePicker(const Board& b, Move ttMove, const Move* killers, Move counterMove,
+               const ButterflyHistory& history);
+    // Quiescence
+    MovePicker(const Board& b, Move ttMove, const ButterflyHistory& history);
+
+    // Move::none() once every move has been returned
+    Move next_move();
+    // Stops the picker from returning any more quiet moves
+    void skip_quiets() { skipQuiets = true; }
+
+private:
+    enum Stage {
+        MAIN_TT, CAPTURE_INIT, GOOD_CAPTURE, REFUTATION, QUIET_INIT, QUIET, BAD_CAPTURE,
+        EVASION_TT, EVASION_INIT, EVASION,
+        QSEARCH_TT, QCAPTURE_INIT, QCAPTURE,
+        DONE
+    };
+
+    bool valid_special(Move m) const;
+    void score_captures(int begin, int end);
+    void score_quiets(int begin, int end);
+    void score_evasions(int begin, int end);
+    // Moves the best-scored move in [cur, end) to cur and returns cur. The
+    // others keep their order, so equal scores stay in generator order.
+    int select_best(int end);
+    bool is_refutation(Move m) const;
+
+    const Board& board;
+    const ButterflyHistory* history = nullptr;
+    Move ttMove;
+    Move refutations[3] = {};
+    int refutationCount = 0;
+    int stage;
+    bool skipQuiets = false;
+
+    // Captures are generated into [0, captureEnd). Losing ones are moved to
+    // [0, badEnd) as they come up and tried after the quiets, which follow
+    // from captureEnd.
+    MoveList moves;
+    int cur = 0;
+    int badEnd = 0;
+    int captureEnd = 0;
+};
+
+} // namespace ct2
+
+#endif // CT2_MOVEPICK_H
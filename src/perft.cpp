@@ -0,0 +1,137 @@
+#include "perft.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include <thread>
+
+namespace ct2 {
+
+namespace {
+
+// Shared between the root workers without locking. Each slot stores the
+// packed (count, depth) word and the key XORed with it, so a slot torn by a
+// concurrent write fails verification instead of returning a wrong count.
+class PerftTable {
+public:
+    explicit PerftTable(size_t mb) {
+        size_t n = 1;
+        while (n * 2 * sizeof(Slot) <= mb * 1024 * 1024) n *= 2;
+        slots.reset(new Slot[n]());
+        mask = n - 1;
+    }
+
+    bool probe(uint64_t key, int depth, uint64_t& count) const {
+        key = salted(key, depth);
+        const Slot& s = slots[key & mask];
+        uint64_t data = s.data.load(std::memory_order_relaxed);
+        uint64_t check = s.check.load(std::memory_order_relaxed);
+        if ((check ^ data) != key || int(data & 0xFF) != depth) return false;
+        count = data >> 8;
+        return true;
+    }
+
+    void store(uint64_t key, int depth, uint64_t count) {
+        key = salted(key, depth);
+        Slot& s = slots[key & mask];
+        uint64_t data = (count << 8) | uint64_t(depth);
+        s.data.store(data, std::memory_order_relaxed);
+        s.check.store(key ^ data, std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> check{0};
+        std::atomic<uint64_t> data{0};
+    };
+
+    // The same position is counted at several depths; spread them apart
+    static uint64_t salted(uint64_t key, int depth) {
+        return key ^ (uint64_t(depth) * 0x9E3779B97F4A7C15ULL);
+    }
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0;
+};
+
+// depth >= 1. The last ply is bulk counted: the legal move count is the
+// number of leaves, so the leaf positions are never made.
+uint64_t perft_rec(Board& b, int depth, PerftTable* table) {
+    uint64_t nodes = 0;
+    if (depth > 1 && table && table->probe(b.key(), depth, nodes)) return nodes;
+
+    MoveList moves;
+    b.generate_legal_moves(moves);
+    if (depth == 1) return moves.size();
+
+    for (Move m : moves) {
+        b.make_move(m);
+        nodes += perft_rec(b, depth - 1, table);
+        b.unmake_move(m);
+    }
+    if (table) table->store(b.key(), depth, nodes);
+    return nodes;
+}
+
+} // namespace
+
+std::vector<PerftEntry> divide(const Board& root, int depth, const PerftOptions& opts) {
+    MoveList moves;
+    root.generate_legal_moves(moves);
+    std::vector<PerftEntry> result(moves.size());
+    for (int i = 0; i < moves.size(); ++i)
+        result[i] = {moves[i], 1};
+    if (depth <= 1 || moves.empty()) return result;
+
+    std::unique_ptr<PerftTable> table;
+    if (opts.hashMB > 0) table.reset(new PerftTable(opts.hashMB));
+
+    // Each worker owns a copy of the board and pulls the next unclaimed
+    // root move, so uneven subtrees still keep every thread busy.
+    std::atomic<int> next{0};
+    auto worker = [&] {
+        Board b = root;
+        for (int i; (i = next.fetch_add(1)) < moves.size();) {
+            b.make_move(moves[i]);
+            result[i].nodes = perft_rec(b, depth - 1, table.get());
+            b.unmake_move(moves[i]);
+        }
+    };
+
+    int threads = std::max(1, std::min(opts.threads, moves.size()));
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
+    return result;
+}
+
+uint64_t perft(const Board& b, int depth, const PerftOptions& opts) {
+    if (depth <= 0) return 1;
+    uint64_t nodes = 0;
+    for (const auto& e : divide(b, depth, opts)) nodes += e.nodes;
+    return nodes;
+}
+
+uint64_t perft_report(const Board& b, int depth, const PerftOptions& opts, std::ostream& out) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t nodes = 0;
+    if (depth <= 0) {
+        nodes = 1;
+    } else {
+        for (const auto& e : divide(b, depth, opts)) {
+            out << move_to_str(e.move) << ": " << e.nodes << '\n';
+            nodes += e.nodes;
+        }
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - start).count();
+    out << "\nNodes searched: " << nodes << '\n'
+        << "Time (ms): " << ms << '\n'
+        << "Nodes/second: " << (ms > 0 ? nodes * 1000 / ms : nodes) << std::endl;
+    return nodes;
+}
+
+} // namespace ct2
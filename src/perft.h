@@ -0,0 +1,32 @@
+#ifndef CT2_PERFT_H
+#define CT2_PERFT_H
+
+#include "board.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+namespace ct2 {
+
+struct PerftOptions {
+    int threads = 1;   // workers sharing out the root moves
+    size_t hashMB = 0; // transposition table size, 0 disables it
+};
+
+struct PerftEntry {
+    Move move;
+    uint64_t nodes;
+};
+
+// Leaf count of the legal move tree below b at the given depth
+uint64_t perft(const Board& b, int depth, const PerftOptions& opts = {});
+// Leaf counts per root move, in generation order
+std::vector<PerftEntry> divide(const Board& b, int depth, const PerftOptions& opts = {});
+// Runs divide and prints "move: nodes" lines followed by the total and speed
+uint64_t perft_report(const Board& b, int depth, const PerftOptions& opts, std::ostream& out);
+
+} // namespace ct2
+
+#endif // CT2_PERFT_H
@@ -0,0 +1,77 @@
+#ifndef CT2_PSQT_H
+#define CT2_PSQT_H
+
+#include "board.h"
+
+#include <array>
+#include <cstdint>
+
+namespace ct2 {
+
+constexpr int VAL_PIECE[6] = {100, 320, 330, 500, 900, 0}; // indexed by piece type, king 0
+
+// Midgame and endgame values packed into one integer: the endgame half in
+// the upper 16 bits, the midgame half in the lower 16 with its sign borrowed
+// from above. Packed scores add and negate like plain ints, so accumulating
+// both phases costs the same as accumulating one.
+using Score = int32_t;
+
+constexpr Score make_score(int mg, int eg) { return Score(int32_t(uint32_t(eg) << 16) + mg); }
+constexpr int mg_value(Score s) { return int16_t(uint16_t(uint32_t(s))); }
+constexpr int eg_value(Score s) { return int16_t(uint16_t(uint32_t(s + 0x8000) >> 16)); }
+
+// Game phase from non-pawn material: knight and bishop 1, rook 2, queen 4.
+// The starting position is PHASE_MIDGAME; promotions may push it higher.
+constexpr int PHASE_WEIGHT[6] = {0, 1, 1, 2, 4, 0};
+constexpr int PHASE_MIDGAME = 24;
+
+namespace psqt_detail {
+
+constexpr int abs(int x) { return x < 0 ? -x : x; }
+constexpr int max(int a, int b) { return a < b ? b : a; }
+
+constexpr Score PIECE_SCORE[6] = {
+    make_score(90, 120), make_score(320, 300), make_score(330, 320),
+    make_score(480, 540), make_score(930, 980), make_score(0, 0)
+};
+
+// Positional bonus of a white piece type; black reads it mirrored
+constexpr Score piece_square(int pieceType, int f, int r) {
+    const int centre = abs(3 - f) + abs(3 - r); // 0 (d4) to 6 (corners)
+    switch (pieceType) {
+        case WP: // pushing matters more as the board empties
+            return make_score(r * 10 + (3 - abs(3 - f)) * 2, r * 18);
+        case WN:
+            return make_score(30 - centre * 4, 20 - centre * 3);
+        case WB:
+            return make_score(30 - max(abs(3 - f), abs(3 - r)) * 3, 20 - max(abs(3 - f), abs(3 - r)) * 2);
+        case WR:
+            return make_score(r * 4, r * 2);
+        case WQ:
+            return make_score(10 - centre, 15 - centre * 2);
+        default: // king: sheltered on the back rank early, central late
+            return make_score(-r * 12 - (f == 3 || f == 4 ? 10 : 0), 20 - centre * 6);
+    }
+}
+
+constexpr std::array<std::array<Score, 64>, PIECE_NB> make_psqt() {
+    std::array<std::array<Score, 64>, PIECE_NB> t{};
+    for (int p = WP; p < PIECE_NB; ++p)
+        for (int sq = 0; sq < 64; ++sq) {
+            const bool black = p >= BP;
+            const int r = black ? 7 - sq / 8 : sq / 8;
+            const Score v = PIECE_SCORE[p % 6] + piece_square(p % 6, sq % 8, r);
+            t[p][sq] = black ? -v : v;
+        }
+    return t;
+}
+
+} // namespace psqt_detail
+
+// Material plus piece-square value of a piece on a square, from white's
+// point of view. Board keeps the sum over all pieces up to date.
+constexpr std::array<std::array<Score, 64>, PIECE_NB> PSQT = psqt_detail::make_psqt();
+
+} // namespace ct2
+
+#endif // CT2_PSQT_H
@@ -0,0 +1,643 @@
+#include "search.h"
+#include "eval.h"
+#include "movepick.h"
+#include "timeman.h"
+#include "tt.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace ct2 {
+
+namespace {
+
+int threadCount = 1;
+SearchFeatures features;
+
+// Raised by stop_search() or once the main thread has finished, so every
+// worker unwinds
+std::atomic<bool> stopSearch{false};
+std::thread searchThread;
+TimeManager timeMan;
+InfoCallback infoCallback;
+
+// Root moves are ordered once, captures first by MVV-LVA; later iterations
+// reorder them as moves raise alpha. Insertion sort keeps generator order
+// among equal scores.
+void order_root_moves(const Board& b, MoveList& list) {
+    for (int i = 0; i < list.count; ++i) list.scores[i] = capture_score(b, list.moves[i]);
+    for (int i = 1; i < list.count; ++i) {
+        Move mv = list.moves[i];
+        int sc = list.scores[i];
+        int j = i - 1;
+        for (; j >= 0 && list.scores[j] < sc; --j) {
+            list.moves[j + 1] = list.moves[j];
+            list.scores[j + 1] = list.scores[j];
+        }
+        list.moves[j + 1] = mv;
+        list.scores[j + 1] = sc;
+    }
+}
+
+// History scores stay within +-HISTORY_MAX, below the MovePicker's
+// EVASION_CAPTURE_BONUS so quiet evasions never outrank capturing ones
+constexpr int HISTORY_MAX = 16384;
+
+// Gravity update: the entry moves toward +-HISTORY_MAX by bonus, by less
+// the closer it already is, so old successes fade instead of saturating
+void update_history(int16_t& entry, int bonus) {
+    entry += int16_t(bonus - entry * std::abs(bonus) / HISTORY_MAX);
+}
+
+// Half-width of the first aspiration window, and the iteration it starts at
+constexpr int ASPIRATION_WINDOW = 25;
+constexpr int ASPIRATION_MIN_DEPTH = 4;
+
+// Reverse futility: a node whose static eval beats beta by this much per
+// ply of remaining depth is assumed to fail high. An improving node is
+// trusted one ply sooner.
+constexpr int RFP_MAX_DEPTH = 7;
+constexpr int RFP_MARGIN = 80;
+
+// Null move: depth reduction R = NMP_BASE_R + depth / NMP_DEPTH_DIVISOR,
+// plus one per NMP_EVAL_DIVISOR the eval exceeds beta (at most 3)
+constexpr int NMP_MIN_DEPTH = 3;
+constexpr int NMP_BASE_R = 3;
+constexpr int NMP_DEPTH_DIVISOR = 4;
+constexpr int NMP_EVAL_DIVISOR = 200;
+
+// Late move reductions apply to quiet moves from this depth and move index
+constexpr int LMR_MIN_DEPTH = 3;
+constexpr int LMR_MIN_MOVES = 3;
+// History worth one ply of reduction
+constexpr int LMR_HISTORY_DIVISOR = 8192;
+
+// Late move pruning skips the remaining quiets once LMP_BASE + depth^2 of
+// them have been searched at a shallow non-PV node, half as many when the
+// node is not improving
+constexpr int LMP_MAX_DEPTH = 3;
+constexpr int LMP_BASE = 3;
+
+// Futility pruning skips quiet moves at frontier nodes whose static eval
+// trails alpha by at least this much
+constexpr int FUTILITY_MARGIN = 200;
+
+// Reduction for the i-th move at the given depth, growing with both
+int lmr_reduction(int depth, int moveIndex) {
+    static const auto table = [] {
+        std::array<std::array<uint8_t, 64>, MAX_PLY + 1> t{};
+        for (int d = 1; d <= MAX_PLY; ++d)
+            for (int m = 1; m < 64; ++m)
+                t[d][m] = uint8_t(0.75 + std::log(d) * std::log(m) / 2.25);
+        return t;
+    }();
+    return table[std::min(depth, MAX_PLY)][std::min(moveIndex, 63)];
+}
+
+// Singular extensions: from this depth, a TT move whose lower bound is at
+// least this recent is tested against the alternatives with a margin of
+// SE_MARGIN per ply of depth
+constexpr int SE_MIN_DEPTH = 7;
+constexpr int SE_TT_DEPTH_SLACK = 3;
+constexpr int SE_MARGIN = 2;
+
+// Quiescence entries are stored with depth 0, below every full-width node
+constexpr int DEPTH_QS = 0;
+// Slack on a capture's material gain before delta pruning drops it
+constexpr int DELTA_MARGIN = 200;
+
+bool is_mate_score(int score) { return std::abs(score) >= VALUE_MATE - MAX_PLY; }
+
+// Mate scores are relative to the root (mate in ply plies), but a table
+// entry may be reached at any ply, so it stores them relative to its node
+int score_to_tt(int score, int ply) {
+    return score >= VALUE_MATE - MAX_PLY ? score + ply
+         : score <= -VALUE_MATE + MAX_PLY ? score - ply : score;
+}
+int score_from_tt(int score, int ply) {
+    return score >= VALUE_MATE - MAX_PLY ? score - ply
+         : score <= -VALUE_MATE + MAX_PLY ? score + ply : score;
+}
+
+// Per-ply state of the current line, indexed by ply
+struct SearchStack {
+    int staticEval = VALUE_NONE;       // VALUE_NONE when in check
+    Move currentMove = Move::none();   // none for a null move
+    Move excludedMove = Move::none();  // set while testing a TT move for singularity
+    Move killers[2] = {};
+};
+
+// One search thread. Everything but the transposition table is private to
+// the worker, so threads never contend on anything else.
+class Worker {
+public:
+    Worker(int id, const Board& b, const SearchLimits& limits)
+        : id(id), board(b), limits(limits) {}
+
+    void iterate();
+
+    const int id;
+    Board board;
+    const SearchLimits& limits;
+    std::atomic<uint64_t> nodes{0};
+    Move bestMove = Move::none();
+    int bestScore = -VALUE_INFINITE;
+    int completedDepth = 0;
+    std::vector<Move> bestPv; // principal variation of completedDepth
+
+private:
+    int search_root(MoveList& moves, int depth, int alpha, int beta);
+    // The stored reply to the move that led to ply
+    Move counter_move(int ply) const {
+        const Move prev = previous_move(ply);
+        return prev != Move::none() ? counterMoves[board.piece_on(prev.to())][prev.to()]
+                                    : Move::none();
+    }
+    void update_quiet_stats(int ply, int depth, Move best, const Move* quiets, int quietCount);
+    // The move that led to the node at ply, none at the root
+    Move previous_move(int ply) const { return ply > 0 ? stack[ply - 1].currentMove : Move::none(); }
+    int negamax(int depth, int ply, int alpha, int beta);
+    int quiescence(int ply, int alpha, int beta);
+    // Score of the position just moved into, from the mover's side. Only
+    // the first move gets the full window; later ones are expected to fail
+    // low against a null window and are re-searched only if they do not.
+    // onPv marks a child that continues the previous iteration's PV. A late
+    // move is first searched reduced and only verified if it beats alpha.
+    int pvs_child(int depth, int ply, int alpha, int beta, bool first, bool onPv,
+                  int reduction = 0) {
+        followPv = onPv;
+        if (first) return -negamax(depth, ply, -beta, -alpha);
+        int score = -negamax(depth - reduction, ply, -alpha - 1, -alpha);
+        if (reduction > 0 && score > alpha && !aborted)
+            score = -negamax(depth, ply, -alpha - 1, -alpha);
+        if (score > alpha && score < beta && !aborted) {
+            followPv = onPv;
+            score = -negamax(depth, ply, -beta, -alpha);
+        }
+        return score;
+    }
+    // Makes mv the head of the PV at ply, followed by the child's PV
+    void update_pv(int ply, Move mv) {
+        pv[ply][ply] = mv;
+        for (int i = ply + 1; i < pvLength[ply + 1]; ++i) pv[ply][i] = pv[ply + 1][i];
+        pvLength[ply] = std::max(pvLength[ply + 1], ply + 1);
+    }
+
+    // Polled every 1024 nodes; a stopped iteration's result is discarded.
+    // Only the main thread looks at the clock and the node budget.
+    bool stopped() {
+        if ((nodes.load(std::memory_order_relaxed) & 1023) == 0) {
+            if (id == 0) check_limits();
+            if (stopSearch.load(std::memory_order_relaxed)) aborted = true;
+        }
+        return aborted;
+    }
+    void check_limits();
+    void count_node(int ply) {
+        nodes.store(nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        seldepth = std::max(seldepth, ply);
+    }
+
+    bool aborted = false;
+    int seldepth = 0;
+    // Triangular PV table: row ply holds the best line found from that ply
+    Move pv[MAX_PLY + 1][MAX_PLY + 1];
+    int pvLength[MAX_PLY + 1] = {};
+    // Last iteration's PV, searched first while the current line follows it
+    Move prevPv[MAX_PLY + 1];
+    int prevPvLength = 0;
+    bool followPv = false;
+
+    SearchStack stack[MAX_PLY + 1];
+    int rootDepth = 0;
+    // Quiet move ordering, learnt from beta cutoffs during this search
+    ButterflyHistory history = {};
+    Move counterMoves[PIECE_NB][64] = {};    // reply to piece landing on square
+};
+
+std::vector<std::unique_ptr<Worker>> workers;
+
+uint64_t total_nodes() {
+    uint64_t n = 0;
+    for (const auto& w : workers) n += w->nodes.load(std::memory_order_relaxed);
+    return n;
+}
+
+// A quiet move caused a beta cutoff: remember it as a killer and as the
+// reply to the previous move, reward it and penalise the quiets tried first
+void Worker::update_quiet_stats(int ply, int depth, Move best, const Move* quiets, int quietCount) {
+    Move* killers = stack[ply].killers;
+    if (killers[0] != best) {
+        killers[1] = killers[0];
+        killers[0] = best;
+    }
+    const Move prev = previous_move(ply);
+    if (prev != Move::none()) counterMoves[board.piece_on(prev.to())][prev.to()] = best;
+
+    const Color us = board.side_to_move();
+    const int bonus = std::min(depth * depth, 400);
+    update_history(history[us][best.from()][best.to()], bonus);
+    for (int i = 0; i < quietCount; ++i)
+        if (quiets[i] != best) update_history(history[us][quiets[i].from()][quiets[i].to()], -bonus);
+}
+
+void Worker::check_limits() {
+    if (timeMan.hard_limit_reached() || (limits.nodes && total_nodes() >= limits.nodes))
+        stopSearch = true;
+}
+
+int Worker::negamax(int depth, int ply, int alpha, int beta) {
+    const bool onPv = followPv;
+    followPv = false;
+    pvLength[ply] = ply;
+    if (depth == 0) {
+        return quiescence(ply, alpha, beta);
+    }
+    count_node(ply);
+    if (stopped()) return 0;
+    if (ply >= MAX_PLY) return evaluate(board);
+
+    // Mate distance pruning: no line from here beats a mate already found
+    // closer to the root
+    alpha = std::max(alpha, -VALUE_MATE + ply);
+    beta = std::min(beta, VALUE_MATE - ply - 1);
+    if (alpha >= beta) return alpha;
+
+    Board& b = board;
+    SearchStack& ss = stack[ply];
+    const Move excluded = ss.excludedMove;
+    const uint64_t key = b.key();
+    const int alphaOrig = alpha;
+    const bool pvNode = beta - alpha > 1;
+    TTData tte;
+    // A singularity test searches the same position without one move, so
+    // it neither uses nor overwrites the full node's entry
+    const bool ttHit = excluded == Move::none() && TT.probe(key, tte);
+    const Move ttMove = ttHit ? tte.move : Move::none();
+    const int ttScore = ttHit ? score_from_tt(tte.score, ply) : VALUE_NONE;
+    // PV nodes are always searched so the principal variation stays intact
+    if (!pvNode && ttHit && tte.depth >= depth) {
+        if (tte.bound == BOUND_EXACT
+            || (tte.bound == BOUND_LOWER && ttScore >= beta)
+            || (tte.bound == BOUND_UPPER && ttScore <= alpha))
+            return ttScore;
+    }
+    const Move pvMove = onPv && ply < prevPvLength ? prevPv[ply] : Move::none();
+
+    const bool inCheck = b.checkers() != 0;
+    const Color us = b.side_to_move();
+    int eval = VALUE_NONE;
+    if (!inCheck) eval = ttHit && tte.eval != VALUE_NONE ? tte.eval : evaluate(b);
+    ss.staticEval = eval;
+    // Improving: the static eval is better than at our previous move, or
+    // the one before that if we were in check then. Pruning is more
+    // careful when the position is getting worse for us.
+    const int prevEval = ply < 2 ? VALUE_NONE
+                       : stack[ply - 2].staticEval != VALUE_NONE || ply < 4 ? stack[ply - 2].staticEval
+                       : stack[ply - 4].staticEval;
+    const bool improving = !inCheck && (prevEval == VALUE_NONE || eval > prevEval);
+
+    if (!pvNode && !inCheck && excluded == Move::none() && !is_mate_score(beta)) {
+        if (features.reverseFutility && depth <= RFP_MAX_DEPTH
+            && eval - RFP_MARGIN * (depth - improving) >= beta)
+            return eval;
+
+        // Give the opponent a free move; if a reduced search still fails
+        // high the position is good enough to cut. Not after another null
+        // move, and not without pieces, where zugzwang makes passing unsound.
+        if (features.nullMove && depth >= NMP_MIN_DEPTH && eval >= beta
+            && previous_move(ply) != Move::none() && b.has_non_pawn_material(us)) {
+            const int R = NMP_BASE_R + depth / NMP_DEPTH_DIVISOR
+                        + std::min((eval - beta) / NMP_EVAL_DIVISOR, 3);
+            ss.currentMove = Move::none();
+            b.make_null_move();
+            int score = -negamax(std::max(depth - 1 - R, 0), ply + 1, -beta, -beta + 1);
+            b.unmake_null_move();
+            if (aborted) return 0;
+            if (score >= beta) return is_mate_score(score) ? beta : score;
+        }
+    }
+
+    // Singular extension: if every alternative to the TT move fails well
+    // below its score, the TT move is the only good one and is extended
+    int singularExtension = 0;
+    if (ply > 0 && depth >= SE_MIN_DEPTH && ttMove != Move::none() && excluded == Move::none()
+        && (tte.bound & BOUND_LOWER) && tte.depth >= depth - SE_TT_DEPTH_SLACK
+        && !is_mate_score(ttScore)) {
+        const int singularBeta = ttScore - SE_MARGIN * depth;
+        ss.excludedMove = ttMove;
+        int score = negamax((depth - 1) / 2, ply, singularBeta - 1, singularBeta);
+        ss.excludedMove = Move::none();
+        if (aborted) return 0;
+        if (score < singularBeta) singularExtension = 1;
+    }
+
+    int best = -VALUE_INFINITE;
+    Move bestMove = Move::none();
+    int legalMoves = 0;
+    int searched = 0;
+    Move quietsTried[64];
+    int quietCount = 0;
+    // Along the previous PV its move is tried first, otherwise the TT move
+    MovePicker picker(b, pvMove != Move::none() ? pvMove : ttMove, ss.killers,
+                      counter_move(ply), history);
+    for (Move mv; (mv = picker.next_move()) != Move::none();) {
+        if (mv == excluded) continue;
+        ++legalMoves;
+        const bool quiet = is_quiet(b, mv);
+        const bool prunable = quiet && !pvNode && !inCheck && !is_mate_score(best)
+                              && best != -VALUE_INFINITE;
+        if (features.futilityPruning && prunable && depth == 1 && eval + FUTILITY_MARGIN <= alpha)
+            continue;
+        if (features.lateMovePruning && prunable && depth <= LMP_MAX_DEPTH
+            && quietCount >= (LMP_BASE + depth * depth) / (2 - improving)) {
+            picker.skip_quiets();
+            continue;
+        }
+        if (quiet && quietCount < 64) quietsTried[quietCount++] = mv;
+        ss.currentMove = mv;
+        b.make_move(mv);
+        const bool givesCheck = b.checkers() != 0;
+        // Checks are extended, but only up to twice the nominal depth so
+        // perpetual checking lines stay finite
+        int extension = mv == ttMove ? singularExtension : 0;
+        if (givesCheck && ply < 2 * rootDepth) extension = 1;
+        // Quiet moves late in the ordering are searched shallower, less
+        // so with good history; checks and killers are not reduced
+        int reduction = 0;
+        if (features.lateMoveReductions && quiet && !inCheck && depth >= LMR_MIN_DEPTH
+            && searched >= LMR_MIN_MOVES && !givesCheck
+            && mv != ss.killers[0] && mv != ss.killers[1]) {
+            reduction = lmr_reduction(depth, searched)
+                      - history[us][mv.from()][mv.to()] / LMR_HISTORY_DIVISOR
+                      - pvNode;
+            reduction = std::clamp(reduction, 0, depth - 2);
+        }
+        int score = pvs_child(depth - 1 + extension, ply + 1, alpha, beta, searched++ == 0,
+                              pvMove != Move::none() && mv == pvMove, reduction);
+        b.unmake_move(mv);
+        if (aborted) return 0;
+        if (score > best) {
+            best = score;
+            bestMove = mv;
+        }
+        if (best > alpha) {
+            alpha = best;
+            if (pvNode) update_pv(ply, mv);
+        }
+        if (alpha >= beta) {
+            if (quiet) update_quiet_stats(ply, depth, mv, quietsTried, quietCount);
+            break;
+        }
+    }
+    if (legalMoves == 0) {
+        if (excluded != Move::none()) return alpha; // the TT move was the only move
+        return inCheck ? -VALUE_MATE + ply : 0;
+    }
+    if (best == -VALUE_INFINITE) best = alpha; // every move was pruned
+    if (excluded == Move::none()) {
+        const Bound bound = best >= beta ? BOUND_LOWER
+                          : best > alphaOrig ? BOUND_EXACT : BOUND_UPPER;
+        TT.store(key, bestMove, score_to_tt(best, ply), eval, depth, bound);
+    }
+    return best;
+}
+
+int Worker::quiescence(int ply, int alpha, int beta) {
+    followPv = false;
+    pvLength[ply] = ply;
+    count_node(ply);
+    if (stopped()) return 0;
+    Board& b = board;
+    const bool inCheck = b.checkers() != 0;
+    if (ply >= MAX_PLY) return inCheck ? 0 : evaluate(b);
+
+    const uint64_t key = b.key();
+    const int alphaOrig = alpha;
+    const bool pvNode = beta - alpha > 1;
+    TTData tte;
+    const bool ttHit = TT.probe(key, tte);
+    const int ttScore = ttHit ? score_from_tt(tte.score, ply) : VALUE_NONE;
+    // Every entry is at least as deep as a quiescence search
+    if (!pvNode && ttHit
+        && (tte.bound == BOUND_EXACT
+            || (tte.bound == BOUND_LOWER && ttScore >= beta)
+            || (tte.bound == BOUND_UPPER && ttScore <= alpha)))
+        return ttScore;
+
+    // In check there is no standing pat: every evasion is searched
+    int eval = VALUE_NONE;
+    int best = -VALUE_INFINITE;
+    if (!inCheck) {
+        eval = ttHit && tte.eval != VALUE_NONE ? tte.eval : evaluate(b);
+        best = eval;
+        if (best >= beta) {
+            if (!ttHit) TT.store(key, Move::none(), score_to_tt(best, ply), eval, DEPTH_QS, BOUND_LOWER);
+            return best;
+        }
+        alpha = std::max(alpha, best);
+    }
+
+    Move bestMove = Move::none();
+    int moveCount = 0;
+    MovePicker picker(b, ttHit ? tte.move : Move::none(), history);
+    for (Move mv; (mv = picker.next_move()) != Move::none();) {
+        ++moveCount;
+        if (!inCheck) {
+            // Delta pruning: even winning the captured piece outright
+            // leaves the score short of alpha
+            if (mv.type() != PROMOTION) {
+                const Piece captured = mv.type() == EN_PASSANT ? make_piece(Color(b.side_to_move() ^ 1), WP)
+                                                               : b.piece_on(mv.to());
+                const int optimistic = eval + VAL_PIECE[captured % 6] + DELTA_MARGIN;
+                if (optimistic <= alpha) {
+                    best = std::max(best, optimistic);
+                    continue;
+                }
+            }
+            if (!b.see(mv)) continue; // a losing exchange will not beat the stand pat
+        }
+        stack[ply].currentMove = mv;
+        b.make_move(mv);
+        int score = -quiescence(ply + 1, -beta, -alpha);
+        b.unmake_move(mv);
+        if (aborted) return 0;
+        if (score > best) {
+            best = score;
+            if (score > alpha) {
+                bestMove = mv;
+                alpha = score;
+                if (pvNode) update_pv(ply, mv);
+                if (alpha >= beta) break;
+            }
+        }
+    }
+    if (inCheck && moveCount == 0) return -VALUE_MATE + ply;
+
+    const Bound bound = best >= beta ? BOUND_LOWER
+                      : pvNode && best > alphaOrig ? BOUND_EXACT : BOUND_UPPER;
+    TT.store(key, bestMove, score_to_tt(best, ply), eval, DEPTH_QS, bound);
+    return best;
+}
+
+// Returns the best score; on raising alpha the move is rotated to the
+// front, so after a search inside the window moves[0] is the best move and
+// is tried first by re-searches and the next iteration
+int Worker::search_root(MoveList& moves, int depth, int alpha, int beta) {
+    int best = -VALUE_INFINITE;
+    pvLength[0] = 0;
+    for (int i = 0; i < moves.size(); ++i) {
+        Move mv = moves[i];
+        stack[0].currentMove = mv;
+        board.make_move(mv);
+        int score = pvs_child(depth - 1, 1, alpha, beta, i == 0,
+                              prevPvLength > 0 && mv == prevPv[0]);
+        board.unmake_move(mv);
+        if (aborted) return 0;
+        if (score > best) {
+            best = score;
+            if (score > alpha) {
+                alpha = score;
+                update_pv(0, mv);
+                std::rotate(moves.begin(), moves.begin() + i, moves.begin() + i + 1);
+                if (alpha >= beta) break;
+            }
+        }
+    }
+    return best;
+}
+
+void Worker::iterate() {
+    MoveList moves;
+    board.generate_legal_moves(moves);
+    order_root_moves(board, moves);
+    bestMove = moves[0]; // something to play if stopped during depth 1
+
+    // Helpers start on alternate depths so the threads spread over
+    // different iterations instead of all searching the same tree in step
+    const int startDepth = 1 + (id & 1);
+    const int maxDepth = limits.depth ? std::min(limits.depth, MAX_PLY)
+                       : limits.infinite || limits.nodes || timeMan.enabled() ? MAX_PLY
+                       : MAX_DEPTH;
+    for (int depth = startDepth; depth <= maxDepth; ++depth) {
+        // Aspiration window around the last score, widened on the failing
+        // side until the score lands inside it
+        int delta = ASPIRATION_WINDOW;
+        int alpha = -VALUE_INFINITE, beta = VALUE_INFINITE;
+        if (depth >= ASPIRATION_MIN_DEPTH && std::abs(bestScore) < VALUE_MATE - MAX_PLY) {
+            alpha = std::max(bestScore - delta, -VALUE_INFINITE);
+            beta = std::min(bestScore + delta, VALUE_INFINITE);
+        }
+        rootDepth = depth;
+        int score;
+        for (;;) {
+            score = search_root(moves, depth, alpha, beta);
+            if (aborted) return;
+            if (score <= alpha) {
+                beta = (alpha + beta) / 2;
+                alpha = std::max(score - delta, -VALUE_INFINITE);
+            } else if (score >= beta) {
+                beta = std::min(score + delta, VALUE_INFINITE);
+            } else {
+                break;
+            }
+            delta += delta / 2;
+        }
+
+        const bool changed = moves[0] != bestMove;
+        bestMove = moves[0];
+        bestScore = score;
+        completedDepth = depth;
+        prevPvLength = pvLength[0];
+        std::copy(pv[0], pv[0] + prevPvLength, prevPv);
+        bestPv.assign(prevPv, prevPv + prevPvLength);
+        if (id == 0 && infoCallback) {
+            int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                             std::chrono::steady_clock::now() - limits.startTime).count();
+            infoCallback({depth, seldepth, score, total_nodes(), ms, bestPv});
+        }
+        if (id == 0 && timeMan.iteration_done(changed)) return;
+        // A mate found within this depth cannot improve by searching deeper
+        if (timeMan.enabled() && std::abs(score) >= VALUE_MATE - depth) return;
+    }
+}
+
+} // namespace
+
+void set_search_threads(int n) { threadCount = std::clamp(n, 1, MAX_THREADS); }
+int search_threads() { return threadCount; }
+
+void set_search_features(const SearchFeatures& f) { features = f; }
+const SearchFeatures& search_features() { return features; }
+
+namespace {
+
+// The stop flag is reset by the callers, before a background thread exists,
+// so a stop sent right after go is never lost
+SearchResult run_search(const Board& b, const SearchLimits& limits, InfoCallback onInfo) {
+    MoveList rootMoves;
+    b.generate_legal_moves(rootMoves);
+    if (rootMoves.empty())
+        return {Move::none(), b.checkers() ? -VALUE_MATE : 0, 0, 0, {}};
+
+    TT.new_search();
+    timeMan.init(limits, b.side_to_move());
+    infoCallback = std::move(onInfo);
+    workers.clear();
+    for (int i = 0; i < threadCount; ++i)
+        workers.emplace_back(new Worker(i, b, limits));
+
+    std::vector<std::thread> helpers;
+    for (int i = 1; i < threadCount; ++i)
+        helpers.emplace_back([i] { workers[i]->iterate(); });
+    workers[0]->iterate();
+    // Infinite analysis reports nothing until told to stop
+    while (limits.infinite && !stopSearch)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    stopSearch = true;
+    for (auto& t : helpers) t.join();
+
+    // Prefer the deepest completed iteration, then the higher score
+    const Worker* best = workers[0].get();
+    for (const auto& w : workers)
+        if (w->completedDepth > best->completedDepth
+            || (w->completedDepth == best->completedDepth && w->bestScore > best->bestScore))
+            best = w.get();
+
+    SearchResult result{best->bestMove, best->bestScore, best->completedDepth, total_nodes(),
+                        best->bestPv};
+    if (result.pv.empty()) result.pv.push_back(result.best);
+    return result;
+}
+
+} // namespace
+
+SearchResult search(const Board& b, const SearchLimits& limits, InfoCallback onInfo) {
+    wait_search();
+    stopSearch = false;
+    return run_search(b, limits, std::move(onInfo));
+}
+
+void start_search(const Board& b, const SearchLimits& limits, InfoCallback onInfo,
+                  std::function<void(const SearchResult&)> onDone) {
+    wait_search();
+    stopSearch = false;
+    searchThread = std::thread([b, limits, onInfo = std::move(onInfo), onDone = std::move(onDone)] {
+        onDone(run_search(b, limits, onInfo));
+    });
+}
+
+void stop_search() { stopSearch = true; }
+
+void wait_search() {
+    if (searchThread.joinable()) searchThread.join();
+}
+
+} // namespace ct2
@@ -0,0 +1,88 @@
+#ifndef CT2_SEARCH_H
+#define CT2_SEARCH_H
+
+#include "board.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace ct2 {
+
+// Scores stay within 16 bits so they fit a transposition table entry
+constexpr int VALUE_MATE = 32000;
+constexpr int VALUE_INFINITE = 32001;
+constexpr int VALUE_NONE = 32002; // no static eval stored
+
+constexpr int MAX_DEPTH = 6; // depth of a plain 'go' without any limit
+constexpr int MAX_PLY = 64;   // iteration limit for timed and infinite searches
+constexpr int MAX_THREADS = 256;
+
+// The arguments of a UCI go command; zero means not given. Times are in
+// milliseconds and measured from startTime, i.e. when go was received.
+struct SearchLimits {
+    int64_t time[COLOR_NB] = {0, 0};
+    int64_t inc[COLOR_NB] = {0, 0};
+    int movestogo = 0;
+    int64_t movetime = 0;
+    int depth = 0;
+    uint64_t nodes = 0;
+    bool infinite = false; // run until stop_search(), even past depth
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    bool use_time_management() const { return time[WHITE] || time[BLACK] || movetime; }
+};
+
+struct SearchResult {
+    Move best = Move::none();
+    int score = 0;
+    int depth = 0;      // deepest iteration completed by the reporting thread
+    uint64_t nodes = 0; // summed over all threads
+    std::vector<Move> pv;
+};
+
+// Progress of the main thread, reported after every completed iteration
+struct SearchInfo {
+    int depth;
+    int seldepth;
+    int score;
+    uint64_t nodes;
+    int64_t timeMs;
+    std::vector<Move> pv;
+};
+using InfoCallback = std::function<void(const SearchInfo&)>;
+
+// Lazy SMP: every thread runs its own iterative deepening on a copy of the
+// board, sharing only the transposition table. The result of the thread
+// that completed the deepest iteration is returned.
+SearchResult search(const Board& b, const SearchLimits& limits, InfoCallback onInfo = nullptr);
+
+// Runs search() on a background thread; onInfo and onDone are called on that
+// thread. A search still running is waited for first.
+void start_search(const Board& b, const SearchLimits& limits, InfoCallback onInfo,
+                  std::function<void(const SearchResult&)> onDone);
+// Asks the running search to finish; it reports the deepest completed
+// iteration. Returns immediately.
+void stop_search();
+// Blocks until the background search, if any, has reported
+void wait_search();
+
+void set_search_threads(int n); // clamped to [1, MAX_THREADS]
+int search_threads();
+
+// Selective search techniques, all on by default. Switching one off is
+// meant for measuring what it is worth, e.g. with ct2 bench.
+struct SearchFeatures {
+    bool nullMove = true;
+    bool lateMoveReductions = true;
+    bool reverseFutility = true;
+    bool lateMovePruning = true;
+    bool futilityPruning = true;
+};
+void set_search_features(const SearchFeatures& f);
+const SearchFeatures& search_features();
+
+} // namespace ct2
+
+#endif // CT2_SEARCH_H
@@ -0,0 +1,62 @@
+#include "timeman.h"
+
+#include <algorithm>
+
+namespace ct2 {
+
+namespace {
+
+// Allowance for GUI and OS latency on every move
+constexpr int64_t MOVE_OVERHEAD = 30;
+// Moves left to plan for under sudden death
+constexpr int DEFAULT_MOVES_TO_GO = 30;
+
+} // namespace
+
+void TimeManager::init(const SearchLimits& limits, Color us) {
+    start = limits.startTime;
+    lastIterationEnd = lastIterationTime = 0;
+    stableIterations = 0;
+    active = !limits.infinite && limits.use_time_management();
+    fixedTime = false;
+    if (!active) return;
+
+    if (limits.movetime) {
+        fixedTime = true;
+        softMs = hardMs = std::max<int64_t>(1, limits.movetime - MOVE_OVERHEAD);
+        return;
+    }
+    const int64_t time = limits.time[us];
+    const int64_t inc = limits.inc[us];
+    const int mtg = limits.movestogo > 0 ? std::min(limits.movestogo, 50) : DEFAULT_MOVES_TO_GO;
+    // Never plan to leave less than the overhead on the clock
+    const int64_t budget = std::max<int64_t>(1, time + inc * (mtg - 1) - MOVE_OVERHEAD * mtg);
+    softMs = std::max<int64_t>(1, budget / mtg);
+    // At most a few times the target, and never more than most of what is left
+    hardMs = std::min(softMs * 4, std::max<int64_t>(1, (time - MOVE_OVERHEAD) * 3 / 4));
+    if (limits.movestogo == 1) hardMs = std::max<int64_t>(1, time - MOVE_OVERHEAD);
+    softMs = std::min(softMs, hardMs);
+}
+
+int64_t TimeManager::elapsed() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - start).count();
+}
+
+bool TimeManager::iteration_done(bool bestMoveChanged) {
+    if (!active || fixedTime) return false;
+    const int64_t now = elapsed();
+    const int64_t iterationTime = now - lastIterationEnd;
+    // Each iteration costs a roughly constant factor more than the last
+    double growth = lastIterationTime > 0 ? double(iterationTime) / lastIterationTime : 2.0;
+    growth = std::clamp(growth, 1.5, 4.0);
+    lastIterationEnd = now;
+    lastIterationTime = iterationTime;
+
+    stableIterations = bestMoveChanged ? 0 : stableIterations + 1;
+    const double stability = std::clamp(1.5 - 0.15 * stableIterations, 0.6, 1.5);
+
+    return now >= softMs * stability || now + iterationTime * growth > hardMs;
+}
+
+} // namespace ct2
@@ -0,0 +1,43 @@
+#ifndef CT2_TIMEMAN_H
+#define CT2_TIMEMAN_H
+
+#include "search.h"
+
+#include <cstdint>
+
+namespace ct2 {
+
+// Turns the clock state of a go command into a soft limit, the time we aim
+// to spend, and a hard limit the search is aborted at. The soft limit is
+// stretched while the best move keeps changing and shrunk once it settles.
+class TimeManager {
+public:
+    void init(const SearchLimits& limits, Color us);
+
+    bool enabled() const { return active; }
+    int64_t elapsed() const;
+    int64_t soft_limit() const { return softMs; }
+    int64_t hard_limit() const { return hardMs; }
+
+    // Cheap enough to call every few thousand nodes
+    bool hard_limit_reached() const { return active && elapsed() >= hardMs; }
+    // Called after each completed iteration. True when the next iteration
+    // should not be started: the soft limit (scaled by best move stability)
+    // is used up, or the next one is predicted to run past the hard limit.
+    // A fixed movetime is spent in full, only the hard limit ends it.
+    bool iteration_done(bool bestMoveChanged);
+
+private:
+    bool active = false;
+    bool fixedTime = false;
+    std::chrono::steady_clock::time_point start;
+    int64_t softMs = 0;
+    int64_t hardMs = 0;
+    int64_t lastIterationEnd = 0;
+    int64_t lastIterationTime = 0;
+    int stableIterations = 0;
+};
+
+} // namespace ct2
+
+#endif // CT2_TIMEMAN_H
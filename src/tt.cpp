@@ -0,0 +1,109 @@
+#include "tt.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace ct2 {
+
+TranspositionTable TT;
+
+namespace {
+
+// data layout: bits 0-15 move, 16-31 score, 32-47 static eval,
+// 48-55 depth, 56-57 bound, 58-63 generation
+uint64_t pack(Move move, int score, int eval, int depth, Bound bound, uint8_t gen) {
+    return uint64_t(move.raw())
+         | uint64_t(uint16_t(int16_t(score))) << 16
+         | uint64_t(uint16_t(int16_t(eval))) << 32
+         | uint64_t(uint8_t(int8_t(depth))) << 48
+         | uint64_t(bound) << 56
+         | uint64_t(gen) << 58;
+}
+
+Move move_of(uint64_t d) { return Move::from_raw(uint16_t(d)); }
+int score_of(uint64_t d) { return int16_t(d >> 16); }
+int eval_of(uint64_t d) { return int16_t(d >> 32); }
+int depth_of(uint64_t d) { return int8_t(d >> 48); }
+Bound bound_of(uint64_t d) { return Bound((d >> 56) & 3); }
+uint8_t gen_of(uint64_t d) { return uint8_t(d >> 58); }
+
+} // namespace
+
+void TranspositionTable::resize(size_t mb) {
+    size_t n = 1;
+    while (n * 2 * sizeof(Bucket) <= std::max<size_t>(mb, 1) * 1024 * 1024) n *= 2;
+    buckets.reset(new Bucket[n]);
+    mask = n - 1;
+    generation = 0;
+}
+
+void TranspositionTable::clear() {
+    for (size_t i = 0; i <= mask; ++i)
+        for (Entry& e : buckets[i].entries) {
+            e.check.store(0, std::memory_order_relaxed);
+            e.data.store(0, std::memory_order_relaxed);
+        }
+    generation = 0;
+}
+
+bool TranspositionTable::probe(uint64_t key, TTData& out) const {
+    for (const Entry& e : bucket(key).entries) {
+        uint64_t data = e.data.load(std::memory_order_relaxed);
+        if ((e.check.load(std::memory_order_relaxed) ^ data) != key
+            || bound_of(data) == BOUND_NONE)
+            continue;
+        out = {move_of(data), score_of(data), eval_of(data), depth_of(data), bound_of(data)};
+        return true;
+    }
+    return false;
+}
+
+void TranspositionTable::store(uint64_t key, Move move, int score, int eval,
+                               int depth, Bound bound) {
+    assert(bound != BOUND_NONE);
+    Entry* entries = bucket(key).entries;
+    uint64_t old[BUCKET_SIZE];
+    int victim = -1;
+    for (int i = 0; i < BUCKET_SIZE; ++i) {
+        old[i] = entries[i].data.load(std::memory_order_relaxed);
+        bool same = (entries[i].check.load(std::memory_order_relaxed) ^ old[i]) == key;
+        if (same || bound_of(old[i]) == BOUND_NONE) {
+            victim = i;
+            if (same && bound_of(old[i]) != BOUND_NONE) {
+                // Same position: keep a deeper result from this search unless
+                // the new one is exact, and never lose a known best move
+                if (bound != BOUND_EXACT && gen_of(old[i]) == generation
+                    && depth_of(old[i]) > depth + 2)
+                    return;
+                if (move == Move::none()) move = move_of(old[i]);
+            }
+            break;
+        }
+    }
+    if (victim < 0) {
+        // Evict the entry worth least: shallow, and left over from old searches
+        auto worth = [&](uint64_t d) {
+            int age = (generation - gen_of(d)) & GEN_MASK;
+            return depth_of(d) - 8 * age;
+        };
+        victim = 0;
+        for (int i = 1; i < BUCKET_SIZE; ++i)
+            if (worth(old[i]) < worth(old[victim])) victim = i;
+    }
+    uint64_t data = pack(move, score, eval, depth, bound, generation);
+    entries[victim].data.store(data, std::memory_order_relaxed);
+    entries[victim].check.store(key ^ data, std::memory_order_relaxed);
+}
+
+int TranspositionTable::hashfull() const {
+    int used = 0;
+    const size_t sample = std::min<size_t>(1000 / BUCKET_SIZE, mask + 1);
+    for (size_t i = 0; i < sample; ++i)
+        for (const Entry& e : buckets[i].entries) {
+            uint64_t d = e.data.load(std::memory_order_relaxed);
+            used += bound_of(d) != BOUND_NONE && gen_of(d) == generation;
+        }
+    return int(used * 1000 / (sample * BUCKET_SIZE));
+}
+
+} // namespace ct2
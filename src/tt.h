@@ -0,0 +1,72 @@
+#ifndef CT2_TT_H
+#define CT2_TT_H
+
+#include "board.h"
+
+#include <cstddef>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace ct2 {
+
+enum Bound : uint8_t {
+    BOUND_NONE,
+    BOUND_UPPER, // score <= true value failed low
+    BOUND_LOWER, // score >= true value failed high
+    BOUND_EXACT = BOUND_UPPER | BOUND_LOWER
+};
+
+// Unpacked contents of a table hit
+struct TTData {
+    Move move;
+    int score;
+    int eval;
+    int depth;
+    Bound bound;
+};
+
+// Fixed-size hash table of 64-byte buckets, four entries each. An entry is
+// one packed 64-bit data word plus the key XORed with it, so scores and evals
+// must fit in 16 bits. Search threads share the table without locks: a slot
+// torn by two concurrent writers no longer verifies and reads as a miss.
+// Replacement prefers empty slots, then the shallowest and oldest entry of
+// the bucket; age comes from a generation counter bumped once per search.
+class TranspositionTable {
+public:
+    explicit TranspositionTable(size_t mb = 16) { resize(mb); }
+
+    void resize(size_t mb); // drops all entries
+    void clear();
+    void new_search() { generation = (generation + 1) & GEN_MASK; }
+
+    bool probe(uint64_t key, TTData& out) const;
+    void store(uint64_t key, Move move, int score, int eval, int depth, Bound bound);
+
+    // Permille of sampled slots written during the current search
+    int hashfull() const;
+    size_t bucket_count() const { return mask + 1; }
+
+private:
+    struct Entry {
+        std::atomic<uint64_t> check{0}; // key ^ data
+        std::atomic<uint64_t> data{0};
+    };
+    static constexpr int BUCKET_SIZE = 4;
+    struct alignas(64) Bucket {
+        Entry entries[BUCKET_SIZE];
+    };
+    static constexpr uint8_t GEN_MASK = 63;
+
+    Bucket& bucket(uint64_t key) const { return buckets[key & mask]; }
+
+    std::unique_ptr<Bucket[]> buckets;
+    size_t mask = 0;
+    uint8_t generation = 0;
+};
+
+extern TranspositionTable TT;
+
+} // namespace ct2
+
+#endif // CT2_TT_H
@@ -1,5 +1,7 @@
 #include "board.h"
 #include "bitops.h"
+#include "eval.h"
+#include "psqt.h"
 #include <gtest/gtest.h>
 
 using namespace ct2;
@@ -18,6 +20,232 @@ TEST(MagicTest, RookAttacks) {
     EXPECT_EQ(popcount64(attacks), 14);
 }
 
+static uint64_t ray_walk(int sq, uint64_t occ, const int (*dirs)[2]) {
+    uint64_t attacks = 0;
+    for (int d = 0; d < 4; ++d) {
+        int r = sq / 8 + dirs[d][0], f = sq % 8 + dirs[d][1];
+        for (; r >= 0 && r < 8 && f >= 0 && f < 8; r += dirs[d][0], f += dirs[d][1]) {
+            attacks |= 1ULL << (r * 8 + f);
+            if (occ & (1ULL << (r * 8 + f))) break;
+        }
+    }
+    return attacks;
+}
+
+static void expect_rays_match() {
+    static const int rookDirs[4][2] = {{1,0},{-1,0},{0,1},{0,-1}};
+    static const int bishopDirs[4][2] = {{1,1},{1,-1},{-1,1},{-1,-1}};
+    uint64_t x = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < 20000; ++i) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        uint64_t occ = x & (x >> 11); // roughly a quarter of the board filled
+        int sq = i % 64;
+        ASSERT_EQ(rook_attacks(sq, occ), ray_walk(sq, occ, rookDirs)) << sq;
+        ASSERT_EQ(bishop_attacks(sq, occ), ray_walk(sq, occ, bishopDirs)) << sq;
+    }
+}
+
+TEST(MagicTest, MatchesRayWalk) {
+    init_magics(SliderBackend::MAGIC);
+    expect_rays_match();
+    if (cpu_has_fast_pext()) {
+        init_magics(SliderBackend::PEXT);
+        EXPECT_EQ(slider_backend(), SliderBackend::PEXT);
+        expect_rays_match();
+    }
+    init_magics();
+}
+
+TEST(BitopsTest, PextPdep) {
+    const uint64_t mask = 0x00FF00000000F00FULL;
+    EXPECT_EQ(pext64(0x00A5000000003001ULL, mask), 0xA531ULL);
+    EXPECT_EQ(pdep64(0xA531ULL, mask), 0x00A5000000003001ULL);
+    for (uint64_t x : {0ULL, ~0ULL, 0x123456789ABCDEF0ULL}) {
+        EXPECT_EQ(pdep64(pext64(x, mask), mask), x & mask);
+#if CT2_BMI2_ASM
+        if (cpu_has_fast_pext()) {
+            EXPECT_EQ(pext64_bmi2(x, mask), pext64(x, mask));
+            EXPECT_EQ(pdep64_bmi2(x, mask), pdep64(x, mask));
+        }
+#endif
+    }
+}
+
+static Move find_move(const Board& b, int from, int to) {
+    for (Move mv : b.generate_legal_moves())
+        if (mv.from() == from && mv.to() == to) return mv;
+    ADD_FAILURE() << "move not found";
+    return Move::none();
+}
+
+TEST(ZobristTest, IncrementalKeyMatchesFEN) {
+    init_tables();
+    Board b;
+    ASSERT_TRUE(b.loadFEN("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"));
+    const int line[][2] = {{4, 6}, {60, 58}, {8, 24}, {25, 16}, {35, 44}};
+    for (const auto& ft : line) {
+        b.make_move(find_move(b, ft[0], ft[1]));
+        Board fresh;
+        ASSERT_TRUE(fresh.loadFEN(b.getFEN()));
+        EXPECT_EQ(b.key(), b.compute_key());
+        EXPECT_EQ(b.key(), fresh.key()) << b.getFEN();
+    }
+}
+
+TEST(ZobristTest, TranspositionsShareKey) {
+    init_tables();
+    Board a, b;
+    ASSERT_TRUE(a.loadFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"));
+    b = a;
+    // 1.Nf3 Nf6 2.Nc3 versus 1.Nc3 Nf6 2.Nf3
+    a.make_move(find_move(a, 6, 21));
+    a.make_move(find_move(a, 62, 45));
+    a.make_move(find_move(a, 1, 18));
+    b.make_move(find_move(b, 1, 18));
+    b.make_move(find_move(b, 62, 45));
+    b.make_move(find_move(b, 6, 21));
+    EXPECT_EQ(a.key(), b.key());
+
+    // a double push with no pawn able to capture en passant leaves no trace
+    Board c, d;
+    ASSERT_TRUE(c.loadFEN("4k3/8/8/8/8/8/4P3/4K3 b - e3 0 1"));
+    ASSERT_TRUE(d.loadFEN("4k3/8/8/8/8/8/4P3/4K3 b - - 0 1"));
+    EXPECT_EQ(c.key(), d.key());
+    ASSERT_TRUE(c.loadFEN("4k3/8/8/8/3pP3/8/8/4K3 b - e3 0 1"));
+    ASSERT_TRUE(d.loadFEN("4k3/8/8/8/3pP3/8/8/4K3 b - - 0 1"));
+    EXPECT_NE(c.key(), d.key());
+}
+
+TEST(ZobristTest, NullMoveRestoresPosition) {
+    init_tables();
+    Board b;
+    ASSERT_TRUE(b.loadFEN("4k3/8/8/8/3pP3/8/8/4K3 b - e3 0 1"));
+    const std::string fen = b.getFEN();
+    const uint64_t key = b.key();
+    b.make_null_move();
+    EXPECT_EQ(b.side_to_move(), WHITE);
+    EXPECT_EQ(b.ep_square_sq(), -1);
+    EXPECT_EQ(b.key(), b.compute_key());
+    b.unmake_null_move();
+    EXPECT_EQ(b.getFEN(), fen);
+    EXPECT_EQ(b.key(), key);
+    EXPECT_FALSE(b.has_non_pawn_material(WHITE));
+}
+
+TEST(SeeTest, ExchangeOutcomes) {
+    init_tables();
+    Board b;
+    // Rxe5 wins an undefended pawn
+    ASSERT_TRUE(b.loadFEN("1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1"));
+    Move rxe5 = find_move(b, 4, 36);
+    EXPECT_TRUE(b.see(rxe5, 0));
+    EXPECT_TRUE(b.see(rxe5, 100));
+    EXPECT_FALSE(b.see(rxe5, 101));
+
+    // Nxe5 loses the knight: the pawn is defended by a knight and a
+    // bishop with the queen x-raying behind it
+    ASSERT_TRUE(b.loadFEN("1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1"));
+    Move nxe5 = find_move(b, 19, 36);
+    EXPECT_FALSE(b.see(nxe5, 0));
+    EXPECT_TRUE(b.see(nxe5, -220));
+
+    // Queen takes a pawn defended by a pawn
+    ASSERT_TRUE(b.loadFEN("4k3/8/3p4/4p3/8/8/8/4QK2 w - - 0 1"));
+    Move qxe5 = find_move(b, 4, 36);
+    EXPECT_FALSE(b.see(qxe5, 0));
+    EXPECT_TRUE(b.see(qxe5, -800));
+
+    // Qxd5 Rxd5 Rxd5 nets a pawn only thanks to the rook behind the queen
+    ASSERT_TRUE(b.loadFEN("3rk3/8/8/3r4/8/8/3Q4/3RK3 w - - 0 1"));
+    Move qxd5 = find_move(b, 11, 35);
+    EXPECT_TRUE(b.see(qxd5, 100));
+    EXPECT_FALSE(b.see(qxd5, 101));
+    EXPECT_EQ(b.attackers_to(35, b.occupancyBB()), (1ULL << 11) | (1ULL << 59));
+    EXPECT_EQ(b.attackers_to(35, b.occupancyBB() ^ (1ULL << 11)), (1ULL << 11) | (1ULL << 3) | (1ULL << 59));
+    ASSERT_TRUE(b.loadFEN("3rk3/8/8/3r4/8/8/3Q4/4K3 w - - 0 1"));
+    EXPECT_FALSE(b.see(find_move(b, 11, 35), 0));
+}
+
+TEST(EvalTest, IncrementalPsqMatchesScratch) {
+    init_tables();
+    Board b;
+    ASSERT_TRUE(b.loadFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"));
+    EXPECT_EQ(b.psq_score(), 0);
+    EXPECT_EQ(b.phase(), PHASE_MIDGAME);
+    ASSERT_TRUE(b.loadFEN("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1"));
+    const int start = b.psq_score();
+    // Random playout through captures, castling and promotions, then back
+    uint64_t x = 0x9E3779B97F4A7C15ULL;
+    std::vector<Move> played;
+    for (int i = 0; i < 200; ++i) {
+        std::vector<Move> moves = b.generate_legal_moves();
+        if (moves.empty()) break;
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        Move m = moves[x % moves.size()];
+        b.make_move(m);
+        played.push_back(m);
+        ASSERT_EQ(b.psq_score(), b.compute_psq()) << b.getFEN();
+        ASSERT_EQ(b.phase(), b.compute_phase()) << b.getFEN();
+        Board fresh;
+        ASSERT_TRUE(fresh.loadFEN(b.getFEN()));
+        ASSERT_EQ(b.psq_score(), fresh.psq_score());
+    }
+    while (!played.empty()) {
+        b.unmake_move(played.back());
+        played.pop_back();
+    }
+    EXPECT_EQ(b.psq_score(), start);
+}
+
+TEST(EvalTest, PackedScores) {
+    for (int mg : {0, 1, -1, 250, -250, 20000, -20000})
+        for (int eg : {0, 1, -1, 300, -300, 20000, -20000}) {
+            Score s = make_score(mg, eg);
+            EXPECT_EQ(mg_value(s), mg);
+            EXPECT_EQ(eg_value(s), eg);
+            EXPECT_EQ(mg_value(-s), -mg);
+            EXPECT_EQ(eg_value(s + make_score(7, -9)), eg - 9);
+        }
+}
+
+TEST(EvalTest, TaperedByPhase) {
+    init_tables();
+    Board b;
+    // Bare kings and pawns are scored purely on the endgame terms, where a
+    // central king beats one on the back rank
+    ASSERT_TRUE(b.loadFEN("4k3/pppp4/8/8/3K4/8/PPPP4/8 w - - 0 1"));
+    EXPECT_EQ(b.phase(), 0);
+    const int centralKing = evaluate(b);
+    ASSERT_TRUE(b.loadFEN("4k3/pppp4/8/8/8/8/PPPP4/3K4 w - - 0 1"));
+    EXPECT_GT(centralKing, evaluate(b));
+    // With all pieces on, the same king walk is penalised
+    ASSERT_TRUE(b.loadFEN("rnbqkbnr/pppppppp/8/8/3K4/8/PPPPPPPP/RNBQ1BNR w kq - 0 1"));
+    EXPECT_LT(evaluate(b), 0);
+    // The evaluation is colour symmetric
+    ASSERT_TRUE(b.loadFEN("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"));
+    Board mirrored;
+    ASSERT_TRUE(mirrored.loadFEN("r3k2r/pppbbppp/2n2q1P/1P2p3/3pn3/BN2PNP1/P1PPQPB1/R3K2R b KQkq - 0 1"));
+    EXPECT_EQ(evaluate(b), evaluate(mirrored));
+}
+
+TEST(MoveTest, PackedEncoding) {
+    static_assert(sizeof(Move) == 2, "moves are packed into 16 bits");
+    Move m(52, 60, PROMOTION, WN);
+    EXPECT_EQ(m.from(), 52);
+    EXPECT_EQ(m.to(), 60);
+    EXPECT_EQ(m.type(), PROMOTION);
+    EXPECT_EQ(m.promotion_type(), WN);
+    EXPECT_EQ(Move(12, 28).type(), NORMAL);
+    EXPECT_NE(Move(12, 28), Move(12, 28, PROMOTION, WQ));
+
+    Board b;
+    ASSERT_TRUE(b.loadFEN("4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1"));
+    DecodedMove d = b.decode(Move(36, 43, EN_PASSANT));
+    EXPECT_EQ(d.piece, WP);
+    EXPECT_EQ(d.capture, BP);
+    EXPECT_TRUE(d.is_ep);
+}
+
 int main(int argc, char** argv) {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
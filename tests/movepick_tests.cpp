@@ -0,0 +1,97 @@
+#include "board.h"
+#include "movepick.h"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace ct2;
+
+namespace {
+
+const char* FENS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1",
+    "4k3/8/8/8/8/8/8/r3K2R w K - 0 1", // in check along the first rank
+};
+
+uint64_t xorshift(uint64_t& x) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return x;
+}
+
+std::vector<uint16_t> sorted_raw(const std::vector<Move>& moves) {
+    std::vector<uint16_t> raw;
+    for (Move m : moves) raw.push_back(m.raw());
+    std::sort(raw.begin(), raw.end());
+    return raw;
+}
+
+} // namespace
+
+TEST(MovePickerTest, PseudoLegalAgreesWithGenerator) {
+    init_tables();
+    uint64_t x = 0x9E3779B97F4A7C15ULL;
+    for (const char* fen : FENS) {
+        Board b;
+        ASSERT_TRUE(b.loadFEN(fen));
+        for (Move m : b.generate_moves()) EXPECT_TRUE(b.is_pseudo_legal(m)) << move_to_str(m);
+        const std::vector<uint16_t> legal = sorted_raw(b.generate_legal_moves());
+        for (int i = 0; i < 20000; ++i) {
+            Move m = Move::from_raw(uint16_t(xorshift(x)));
+            bool found = std::binary_search(legal.begin(), legal.end(), m.raw());
+            ASSERT_EQ(b.is_pseudo_legal(m) && b.is_legal(m), found) << fen << " " << move_to_str(m);
+        }
+    }
+}
+
+TEST(MovePickerTest, ReturnsEveryLegalMoveOnce) {
+    init_tables();
+    static ButterflyHistory history = {};
+    uint64_t x = 0x2545F4914F6CDD1DULL;
+    for (int i = 0; i < 64; ++i)
+        for (int j = 0; j < 64; ++j) history[WHITE][i][j] = int16_t(xorshift(x) % 2000 - 1000);
+    for (const char* fen : FENS) {
+        Board b;
+        ASSERT_TRUE(b.loadFEN(fen));
+        const std::vector<Move> legal = b.generate_legal_moves();
+        // Special moves both from this position and random, mostly invalid ones
+        for (int trial = 0; trial < 50; ++trial) {
+            Move tt = trial % 2 ? legal[xorshift(x) % legal.size()] : Move::from_raw(uint16_t(xorshift(x)));
+            Move killers[2] = {legal[xorshift(x) % legal.size()], Move::from_raw(uint16_t(xorshift(x)))};
+            Move counter = legal[xorshift(x) % legal.size()];
+            MovePicker picker(b, tt, killers, counter, history);
+            std::vector<Move> picked;
+            for (Move m; (m = picker.next_move()) != Move::none();) picked.push_back(m);
+            ASSERT_EQ(sorted_raw(picked), sorted_raw(legal)) << fen;
+            if (std::find(legal.begin(), legal.end(), tt) != legal.end()) {
+                EXPECT_EQ(picked.front(), tt);
+            }
+        }
+    }
+}
+
+TEST(MovePickerTest, QuiescenceReturnsCapturesBestFirst) {
+    init_tables();
+    Board b;
+    // The queen on d5 can be taken by the pawn and the rook
+    ASSERT_TRUE(b.loadFEN("4k3/8/8/3q4/4P3/8/3R4/4K3 w - - 0 1"));
+    static const ButterflyHistory history = {};
+    MovePicker picker(b, Move::none(), history);
+    EXPECT_EQ(move_to_str(picker.next_move()), "e4d5");
+    EXPECT_EQ(move_to_str(picker.next_move()), "d2d5");
+    EXPECT_EQ(picker.next_move(), Move::none());
+
+    // In check the quiescence picker returns every evasion
+    ASSERT_TRUE(b.loadFEN("4k3/8/8/8/8/8/8/r3K2R w K - 0 1"));
+    MovePicker evasions(b, Move::none(), history);
+    std::vector<Move> picked;
+    for (Move m; (m = evasions.next_move()) != Move::none();) picked.push_back(m);
+    EXPECT_EQ(sorted_raw(picked), sorted_raw(b.generate_legal_moves()));
+}
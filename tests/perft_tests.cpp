@@ -0,0 +1,61 @@
+#include "board.h"
+#include "perft.h"
+#include <gtest/gtest.h>
+
+using namespace ct2;
+
+namespace {
+
+struct PerftCase {
+    const char* fen;
+    int depth;
+    uint64_t nodes;
+};
+
+// Reference counts from the chessprogramming wiki perft results page
+const PerftCase CASES[] = {
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609},
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603},
+    {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624},
+    {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333},
+    {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487},
+    {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594},
+};
+
+} // namespace
+
+TEST(PerftTest, ReferencePositions) {
+    init_tables();
+    for (const auto& c : CASES) {
+        Board b;
+        ASSERT_TRUE(b.loadFEN(c.fen));
+        EXPECT_EQ(perft(b, c.depth), c.nodes) << c.fen;
+    }
+}
+
+TEST(PerftTest, ThreadsAndHashAgree) {
+    init_tables();
+    PerftOptions opts;
+    opts.threads = 4;
+    opts.hashMB = 8;
+    for (const auto& c : CASES) {
+        Board b;
+        ASSERT_TRUE(b.loadFEN(c.fen));
+        const std::string before = b.getFEN();
+        EXPECT_EQ(perft(b, c.depth, opts), c.nodes) << c.fen;
+        EXPECT_EQ(b.getFEN(), before); // workers only ever touch copies
+    }
+}
+
+TEST(PerftTest, DivideSumsToPerft) {
+    init_tables();
+    Board b;
+    ASSERT_TRUE(b.loadFEN(CASES[1].fen));
+    auto entries = divide(b, 3);
+    EXPECT_EQ(entries.size(), 48u);
+    uint64_t sum = 0;
+    for (const auto& e : entries) sum += e.nodes;
+    EXPECT_EQ(sum, 97862u);
+    EXPECT_EQ(perft(b, 0), 1u);
+    EXPECT_EQ(perft(b, 1), 48u);
+}
@@ -1,5 +1,6 @@
 #include "board.h"
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 
@@ -27,7 +28,8 @@ TEST(MoveGeneration, RandomPositions) {
         Board b;
         ASSERT_TRUE(b.loadFEN(fen.str())) << fen.str();
         auto moves = b.generate_moves();
-        for(const auto& mv : moves) {
+        for(Move m : moves) {
+            const DecodedMove mv = b.decode(m);
             // piece must exist on from square
             EXPECT_TRUE(b.pieceBB(mv.piece) & (1ULL<<mv.from)) << fen.str();
             // destination must be empty or contain capture target
@@ -50,3 +52,106 @@ TEST(MoveGeneration, RandomPositions) {
     EXPECT_GE(count, 200);
 }
 
+
+static bool mailbox_matches_bitboards(const Board& b) {
+    for (int sq = 0; sq < 64; ++sq) {
+        Piece expected = PIECE_NB;
+        for (int p = WP; p < PIECE_NB; ++p)
+            if (b.pieceBB((Piece)p) & (1ULL << sq)) expected = (Piece)p;
+        if (b.piece_on(sq) != expected) return false;
+    }
+    return true;
+}
+
+TEST(MoveGeneration, MakeUnmakeRoundTrip) {
+    init_tables();
+    std::ifstream in("tests/random_positions.txt");
+    ASSERT_TRUE(in.is_open());
+    std::string line;
+    int count = 0;
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        Board b;
+        ASSERT_TRUE(b.loadFEN(line)) << line;
+        const std::string fen = b.getFEN();
+        const uint64_t key = b.key();
+        const uint64_t occ = b.occupancyBB();
+        for (Move mv : b.generate_moves()) {
+            Color us = b.side_to_move();
+            bool legal = b.is_legal(mv);
+            b.make_move(mv);
+            // is_legal must agree with actually playing the move; castling
+            // through an attacked square is the one case it cannot see
+            if (mv.type() != CASTLING) {
+                EXPECT_EQ(legal, !b.in_check(us)) << line;
+            }
+            EXPECT_TRUE(mailbox_matches_bitboards(b)) << line;
+            b.unmake_move(mv);
+            EXPECT_TRUE(mailbox_matches_bitboards(b)) << line;
+            EXPECT_EQ(b.getFEN(), fen) << line;
+            EXPECT_EQ(b.key(), key) << line;
+            EXPECT_EQ(b.occupancyBB(), occ) << line;
+        }
+        ++count;
+    }
+    EXPECT_GE(count, 200);
+}
+
+static std::vector<uint16_t> sorted_raw(const MoveList& list, const Board& b, bool filterLegal) {
+    std::vector<uint16_t> raw;
+    for (Move m : list)
+        if (!filterLegal || b.is_legal(m)) raw.push_back(m.raw());
+    std::sort(raw.begin(), raw.end());
+    return raw;
+}
+
+TEST(MoveGeneration, StagedGeneratorsMatchFullGenerator) {
+    init_tables();
+    std::ifstream in("tests/random_positions.txt");
+    ASSERT_TRUE(in.is_open());
+    std::vector<std::string> fens;
+    std::string line;
+    while (std::getline(in, line))
+        if (!line.empty()) fens.push_back(line);
+    // a few positions in check, including ep and double-check evasions
+    fens.push_back("4k3/8/8/3pP3/8/8/8/4K2q w - d6 0 1");
+    fens.push_back("8/8/8/2k5/3Pp3/8/8/4K3 b - d3 0 1");
+    fens.push_back("4k3/8/8/8/8/5n2/8/r3K3 w - - 0 1");
+    fens.push_back("4k3/8/8/8/1b6/8/3P4/4K3 w - - 0 1");
+
+    int evasionPositions = 0;
+    for (const auto& fen : fens) {
+        Board b;
+        ASSERT_TRUE(b.loadFEN(fen)) << fen;
+        MoveList all, staged, legal;
+        b.generate_moves(all);
+        b.generate<CAPTURES>(staged);
+        b.generate<QUIETS>(staged);
+        b.generate_legal_moves(legal);
+        EXPECT_EQ(sorted_raw(staged, b, false), sorted_raw(all, b, true)) << fen;
+        EXPECT_EQ(sorted_raw(legal, b, false), sorted_raw(all, b, true)) << fen;
+
+        if (b.checkers()) {
+            ++evasionPositions;
+            MoveList evasions;
+            b.generate<EVASIONS>(evasions);
+            EXPECT_EQ(sorted_raw(evasions, b, false), sorted_raw(all, b, true)) << fen;
+            continue;
+        }
+
+        MoveList quiets, checks;
+        b.generate<QUIETS>(quiets);
+        b.generate<QUIET_CHECKS>(checks);
+        std::vector<uint16_t> expected;
+        for (Move m : quiets) {
+            if (m.type() == CASTLING || !b.is_legal(m)) continue;
+            Color them = Color(b.side_to_move() ^ 1);
+            b.make_move(m);
+            if (b.in_check(them)) expected.push_back(m.raw());
+            b.unmake_move(m);
+        }
+        std::sort(expected.begin(), expected.end());
+        EXPECT_EQ(sorted_raw(checks, b, false), expected) << fen;
+    }
+    EXPECT_GE(evasionPositions, 4);
+}
@@ -0,0 +1,115 @@
+#include "board.h"
+#include "search.h"
+#include "tt.h"
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace ct2;
+
+namespace {
+
+SearchResult search_fen(const char* fen, int depth, int threads) {
+    init_tables();
+    Board b;
+    EXPECT_TRUE(b.loadFEN(fen));
+    TT.clear();
+    set_search_threads(threads);
+    SearchLimits limits;
+    limits.depth = depth;
+    SearchResult r = search(b, limits);
+    set_search_threads(1);
+    return r;
+}
+
+} // namespace
+
+TEST(SearchTest, FindsMateInOne) {
+    // Back-rank mate: Rd8#
+    for (int threads : {1, 4}) {
+        SearchResult r = search_fen("6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1", 3, threads);
+        EXPECT_EQ(move_to_str(r.best), "d1d8") << threads;
+        EXPECT_EQ(r.score, VALUE_MATE - 1) << threads;
+        EXPECT_EQ(r.depth, 3) << threads;
+        EXPECT_GT(r.nodes, 0u) << threads;
+    }
+}
+
+TEST(SearchTest, ScoresMateByDistance) {
+    // Rd8+ Rxd8 Rxd8#: mate in two moves, three plies
+    SearchResult r = search_fen("r5k1/5ppp/8/8/8/8/3R1PPP/3R2K1 w - - 0 1", 6, 1);
+    EXPECT_EQ(r.score, VALUE_MATE - 3);
+    EXPECT_EQ(move_to_str(r.best), "d2d8");
+}
+
+TEST(SearchTest, PrefersMateToStalemate) {
+    // Qc8# mates, while Qc7 leaves black without a move but not in check
+    SearchResult r = search_fen("k7/8/1K6/8/8/8/8/2Q5 w - - 0 1", 2, 1);
+    EXPECT_EQ(move_to_str(r.best), "c1c8");
+    EXPECT_EQ(r.score, VALUE_MATE - 1);
+}
+
+TEST(SearchTest, WinsHangingQueen) {
+    for (int threads : {1, 3}) {
+        SearchResult r = search_fen("4k3/8/8/3q4/8/8/3R4/4K3 w - - 0 1", 4, threads);
+        EXPECT_EQ(move_to_str(r.best), "d2d5") << threads;
+    }
+}
+
+TEST(SearchTest, PrincipalVariationIsLegalLine) {
+    init_tables();
+    Board b;
+    ASSERT_TRUE(b.loadFEN("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"));
+    TT.clear();
+    SearchLimits limits;
+    limits.depth = 5;
+    std::vector<SearchInfo> infos;
+    SearchResult r = search(b, limits, [&](const SearchInfo& info) { infos.push_back(info); });
+    ASSERT_EQ(infos.size(), 5u);
+    for (size_t i = 0; i < infos.size(); ++i) {
+        EXPECT_EQ(infos[i].depth, int(i) + 1);
+        EXPECT_GE(infos[i].seldepth, infos[i].depth);
+        EXPECT_FALSE(infos[i].pv.empty());
+    }
+    ASSERT_GE(r.pv.size(), 2u);
+    EXPECT_EQ(r.pv[0], r.best);
+    EXPECT_EQ(r.pv, infos.back().pv);
+    for (Move m : r.pv) {
+        ASSERT_TRUE(b.is_legal(m)) << move_to_str(m);
+        b.make_move(m);
+    }
+}
+
+TEST(SearchTest, NoLegalMoves) {
+    SearchResult mate = search_fen("7k/6Q1/6K1/8/8/8/8/8 b - - 0 1", 3, 1);
+    EXPECT_EQ(mate.best, Move::none());
+    EXPECT_EQ(mate.score, -VALUE_MATE);
+    SearchResult stalemate = search_fen("7k/8/6QK/8/8/8/8/8 b - - 0 1", 3, 1);
+    EXPECT_EQ(stalemate.best, Move::none());
+    EXPECT_EQ(stalemate.score, 0);
+}
+
+TEST(SearchTest, BackgroundSearchStopsOnRequest) {
+    init_tables();
+    Board b;
+    ASSERT_TRUE(b.loadFEN("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"));
+    TT.clear();
+    SearchLimits limits;
+    limits.infinite = true;
+    SearchResult result;
+    bool reported = false;
+    start_search(b, limits, nullptr, [&](const SearchResult& r) {
+        result = r;
+        reported = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(reported); // infinite analysis waits for stop
+    stop_search();
+    wait_search();
+    ASSERT_TRUE(reported);
+    EXPECT_NE(result.best, Move::none());
+    EXPECT_TRUE(b.is_legal(result.best));
+    EXPECT_GT(result.nodes, 0u);
+}
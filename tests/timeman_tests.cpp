@@ -0,0 +1,93 @@
+#include "board.h"
+#include "search.h"
+#include "timeman.h"
+#include "tt.h"
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+using namespace ct2;
+
+TEST(TimeManTest, LimitsFromClock) {
+    SearchLimits limits;
+    limits.time[WHITE] = 60000;
+    limits.inc[WHITE] = 1000;
+    limits.time[BLACK] = 1000; // not ours
+    TimeManager tm;
+    tm.init(limits, WHITE);
+    ASSERT_TRUE(tm.enabled());
+    EXPECT_GT(tm.soft_limit(), 1000);
+    EXPECT_LT(tm.soft_limit(), 10000);
+    EXPECT_LE(tm.soft_limit(), tm.hard_limit());
+    EXPECT_LT(tm.hard_limit(), 60000);
+
+    tm.init(limits, BLACK);
+    EXPECT_LT(tm.hard_limit(), 1000);
+    EXPECT_GE(tm.soft_limit(), 1);
+}
+
+TEST(TimeManTest, MovetimeAndLastMoveBeforeControl) {
+    SearchLimits limits;
+    limits.movetime = 500;
+    TimeManager tm;
+    tm.init(limits, WHITE);
+    EXPECT_EQ(tm.soft_limit(), tm.hard_limit());
+    EXPECT_LT(tm.hard_limit(), 500);
+    // A settled best move does not cut a fixed movetime short
+    for (int i = 0; i < 10; ++i) EXPECT_FALSE(tm.iteration_done(false));
+
+    SearchLimits last;
+    last.time[WHITE] = 5000;
+    last.movestogo = 1;
+    tm.init(last, WHITE);
+    EXPECT_GT(tm.hard_limit(), 4000);
+    EXPECT_LT(tm.hard_limit(), 5000);
+}
+
+TEST(TimeManTest, DisabledWithoutClock) {
+    SearchLimits limits;
+    limits.depth = 5;
+    TimeManager tm;
+    tm.init(limits, WHITE);
+    EXPECT_FALSE(tm.enabled());
+    EXPECT_FALSE(tm.hard_limit_reached());
+    EXPECT_FALSE(tm.iteration_done(true));
+}
+
+TEST(TimeManTest, SearchHonoursMovetimeAndNodes) {
+    init_tables();
+    Board b;
+    ASSERT_TRUE(b.loadFEN("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"));
+    TT.clear();
+    SearchLimits timed;
+    timed.movetime = 200;
+    auto start = std::chrono::steady_clock::now();
+    SearchResult r = search(b, timed);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - start).count();
+    EXPECT_NE(r.best, Move::none());
+    EXPECT_GE(ms, 150);
+    EXPECT_LT(ms, 400);
+
+    SearchLimits counted;
+    counted.nodes = 20000;
+    r = search(b, counted);
+    EXPECT_NE(r.best, Move::none());
+    EXPECT_LT(r.nodes, 20000u + 2048);
+}
+
+TEST(TimeManTest, TimedSearchStopsOnProvenMate) {
+    init_tables();
+    Board b;
+    ASSERT_TRUE(b.loadFEN("6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1"));
+    TT.clear();
+    SearchLimits timed;
+    timed.movetime = 2000;
+    auto start = std::chrono::steady_clock::now();
+    SearchResult r = search(b, timed);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - start).count();
+    EXPECT_EQ(r.score, VALUE_MATE - 1);
+    EXPECT_LT(r.depth, 4);
+    EXPECT_LT(ms, 1000);
+}
@@ -0,0 +1,52 @@
+#include "tt.h"
+#include <gtest/gtest.h>
+
+using namespace ct2;
+
+TEST(TTTest, StoreAndProbe) {
+    TranspositionTable tt(1);
+    const uint64_t key = 0x123456789ABCDEF0ULL;
+    TTData d;
+    EXPECT_FALSE(tt.probe(key, d));
+    tt.store(key, Move(12, 28), -31000, 57, 9, BOUND_LOWER);
+    ASSERT_TRUE(tt.probe(key, d));
+    EXPECT_EQ(d.move, Move(12, 28));
+    EXPECT_EQ(d.score, -31000);
+    EXPECT_EQ(d.eval, 57);
+    EXPECT_EQ(d.depth, 9);
+    EXPECT_EQ(d.bound, BOUND_LOWER);
+    EXPECT_FALSE(tt.probe(key ^ 1, d));
+    tt.clear();
+    EXPECT_FALSE(tt.probe(key, d));
+}
+
+TEST(TTTest, SizeIsBoundedPowerOfTwo) {
+    TranspositionTable tt(3);
+    size_t n = tt.bucket_count();
+    EXPECT_EQ(n & (n - 1), 0u);
+    EXPECT_LE(n * 64, 3u * 1024 * 1024);
+    EXPECT_GT(n * 64 * 2, 3u * 1024 * 1024);
+}
+
+TEST(TTTest, KeepsMoveAndReplacesOldEntries) {
+    TranspositionTable tt(1);
+    const size_t buckets = tt.bucket_count();
+    const uint64_t key = 42;
+    tt.store(key, Move(1, 2), 10, 0, 5, BOUND_EXACT);
+    // A later result without a move keeps the known best move
+    tt.store(key, Move::none(), 20, 0, 6, BOUND_UPPER);
+    TTData d;
+    ASSERT_TRUE(tt.probe(key, d));
+    EXPECT_EQ(d.move, Move(1, 2));
+    EXPECT_EQ(d.score, 20);
+
+    // Fill the rest of the bucket, then a new search evicts stale entries
+    for (uint64_t i = 1; i < 4; ++i)
+        tt.store(key + i * buckets, Move::none(), 0, 0, 20, BOUND_EXACT);
+    tt.new_search();
+    tt.new_search();
+    tt.store(key + 4 * buckets, Move(3, 4), 0, 0, 1, BOUND_EXACT);
+    EXPECT_TRUE(tt.probe(key + 4 * buckets, d));
+    EXPECT_FALSE(tt.probe(key, d)); // the shallowest stale entry went
+    EXPECT_EQ(tt.hashfull(), 1); // one of the 1000 sampled slots is current
+}